@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Fires a million random rays at the bvh of the scene of main.cpp
+// through the batch API of raytracer_core, and reports the throughput
+// of the closest hit and occlusion batches against a loop of single
+// queries. The results are checked by test_batch
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "batch.hpp"
+#include "common.hpp"
+
+int main(void)
+{
+  hittable_list list;
+  build_scene([&](const point3& center, double radius, std::shared_ptr<material> mat)
+  {
+    list.add(std::make_shared<sphere>(center, radius, mat));
+  });
+  bvh world(list);
+
+  // Rays from above the scene towards the ground, half of them short
+  // enough to stop before it, like shadow rays
+  const std::size_t count = 1 << 20;
+  std::vector<double> origins(3 * count), directions(3 * count);
+  std::vector<double> t_min(count, 0.001), t_max(count);
+  random_seed(1);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    auto origin    = point3(random_double(-12, 12), random_double(0.5, 4), random_double(-12, 12));
+    auto direction = unit_vector(vec3(random_double(-1, 1), -1, random_double(-1, 1)));
+    for (int k = 0; k < 3; ++k)
+    {
+      origins[3 * i + k]    = origin[k];
+      directions[3 * i + k] = direction[k];
+    }
+    t_max[i] = (i % 2) ? infinity : random_double(0.5, 4);
+  }
+  ray_batch rays{ origins.data(), directions.data(), t_min.data(), t_max.data(), count };
+
+  std::vector<double>        t(count), normals(3 * count);
+  std::vector<std::int32_t>  primitives(count);
+  std::vector<std::uint64_t> occluded((count + 63) / 64);
+  hit_batch hits{ t.data(), normals.data(), primitives.data() };
+
+  auto intersect_time = seconds([&] { intersect_batch(world, rays, hits); });
+  auto occluded_time  = seconds([&] { occluded_batch(world, rays, occluded.data()); });
+  auto single_time    = seconds([&]
+  {
+    hit_record rec;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      ray r(point3(origins[3 * i], origins[3 * i + 1], origins[3 * i + 2]),
+            vec3(directions[3 * i], directions[3 * i + 1], directions[3 * i + 2]));
+      t[i] = world.hit(r, interval(t_min[i], t_max[i]), rec) ? rec.t : infinity;
+    }
+  });
+
+  std::cout << default_thread_pool().size() << " workers, " << count << " rays\n"
+            << "single queries: " << count / single_time / 1e6 << " Mrays/s\n"
+            << "intersect_batch: " << count / intersect_time / 1e6 << " Mrays/s\n"
+            << "occluded_batch: " << count / occluded_time / 1e6 << " Mrays/s\n";
+  return 0;
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Times the fast math kernels against the standard functions they
+// replace, and reports their largest error on the timed inputs. The
+// bounds of fast_math.hpp are checked by test_fast_math
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "common.hpp"
+
+struct kernel_report
+{
+  const char* name;
+  double      max_error = 0;
+  double      std_seconds = 0;
+  double      fast_seconds = 0;
+};
+
+// Fills [inputs] with [count] samples of [sample]
+template <typename Sample>
+std::vector<double> make_inputs(std::size_t count, Sample sample)
+{
+  std::vector<double> inputs(count);
+  for (auto& x : inputs)
+    x = sample();
+  return inputs;
+}
+
+// Measures [fast] against [reference] on [inputs]. [error] computes
+// the error of one result
+template <typename Reference, typename Fast, typename Error>
+void measure(kernel_report& report, const std::vector<double>& inputs,
+             Reference reference, Fast fast, Error error)
+{
+  for (auto x : inputs)
+    report.max_error = std::max(report.max_error, error(fast(x), reference(x)));
+
+  volatile double sink = 0;
+  report.std_seconds = seconds([&]
+  {
+    double sum = 0;
+    for (auto x : inputs)
+      sum += reference(x);
+    sink = sum;
+  });
+  report.fast_seconds = seconds([&]
+  {
+    double sum = 0;
+    for (auto x : inputs)
+      sum += fast(x);
+    sink = sum;
+  });
+  (void)sink;
+}
+
+int main(void)
+{
+  constexpr std::size_t count = 2000000;
+  random_seed(0);
+
+  auto relative = [](double a, double b) { return std::fabs(a / b - 1); };
+  auto absolute = [](double a, double b) { return std::fabs(a - b); };
+
+  std::vector<kernel_report> reports;
+
+  kernel_report rsqrt{ "rsqrt" };
+  measure(rsqrt, make_inputs(count, [] { return std::exp2(random_double(-100, 100)); }),
+          [](double x) { return 1 / std::sqrt(x); },
+          [](double x) { return fast_rsqrt(x); }, relative);
+  reports.push_back(rsqrt);
+
+  kernel_report pow5{ "ipow<5>" };
+  measure(pow5, make_inputs(count, [] { return random_double(0, 2); }),
+          [](double x) { return std::pow(x, 5); },
+          [](double x) { return ipow<5>(x); }, relative);
+  reports.push_back(pow5);
+
+  auto angles = make_inputs(count, [] { return random_double(-1e3, 1e3); });
+  kernel_report sine{ "sincos (sin)" };
+  measure(sine, angles, [](double x) { return std::sin(x); },
+          [](double x) { double s, c; fast_sincos(x, s, c); return s; }, absolute);
+  reports.push_back(sine);
+
+  kernel_report cosine{ "sincos (cos)" };
+  measure(cosine, angles, [](double x) { return std::cos(x); },
+          [](double x) { double s, c; fast_sincos(x, s, c); return c; }, absolute);
+  reports.push_back(cosine);
+
+  kernel_report tangent{ "tan" };
+  measure(tangent, make_inputs(count, [] { return random_double(-1.5, 1.5); }),
+          [](double x) { return std::tan(x); },
+          [](double x) { return fast_tan(x); }, relative);
+  reports.push_back(tangent);
+
+  for (const auto& r : reports)
+    std::cout << r.name << ": max error " << r.max_error << ", "
+              << r.std_seconds / r.fast_seconds << "x faster than the standard function\n";
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Writes a paged scene of a million spheres, about 40 MiB, and
+// fires the same rays at it with resident budgets from a tenth of
+// the file to all of it. For each budget reports the throughput of
+// single hit() queries and of hit_batch(), and the chunks paged in
+// by each
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "paged_scene.hpp"
+#include "common.hpp"
+
+int main(void)
+{
+  std::vector<std::shared_ptr<material>> materials = {
+    std::make_shared<lambertian>(color(0.5, 0.5, 0.5))
+  };
+
+  random_seed(1);
+  std::vector<paged_sphere> spheres(1 << 20);
+  for (auto& s : spheres)
+    s = { { float(random_double(-100, 100)), float(random_double(-100, 100)),
+            float(random_double(-100, 100)) }, float(random_double(0.05, 0.4)), 0 };
+  const char* path = "bench_paged.rtoc";
+  if (!write_paged_scene(spheres, path))
+    return 1;
+
+  // Rays from all around the scene towards random points inside it,
+  // so that every part of the file is needed
+  std::vector<ray> rays;
+  for (int i = 0; i < 50000; ++i)
+  {
+    auto origin = 150 * random_unit_vector();
+    rays.emplace_back(origin, vec3::random(-100, 100) - origin);
+  }
+
+  std::cout << spheres.size() << " spheres, " << rays.size() << " rays\n";
+  for (std::size_t budget_mib : { 4, 8, 16, 32, 64 })
+  {
+    std::uint64_t single_page_ins = 0, batch_page_ins = 0;
+    auto single_time = seconds([&]
+    {
+      paged_scene scene(path, materials, budget_mib << 20);
+      hit_record rec;
+      for (const auto& r : rays)
+        scene.hit(r, interval(0.001, infinity), rec);
+      single_page_ins = scene.page_ins();
+    });
+    auto batch_time = seconds([&]
+    {
+      paged_scene scene(path, materials, budget_mib << 20);
+      std::vector<hit_record> recs;
+      scene.hit_batch(rays, interval(0.001, infinity), recs);
+      batch_page_ins = scene.page_ins();
+    });
+
+    std::cout << budget_mib << " MiB budget: hit() " << rays.size() / single_time / 1e6
+              << " Mrays/s, " << single_page_ins << " page ins; hit_batch() "
+              << rays.size() / batch_time / 1e6 << " Mrays/s, " << batch_page_ins
+              << " page ins\n";
+  }
+
+  std::remove(path);
+  return 0;
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Renders a dim room, lit by the sky through a single opening in its
+// wall, with and without path guiding. The variance of each mode is
+// estimated from two renders with different seeds, and the efficiency
+// is the inverse of variance times render time, so a ratio above 1
+// means that guiding reaches a given noise level faster
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "raytracer.hpp"
+#include "common.hpp"
+
+// Mean squared difference of [a] and [b], in linear space
+double mse(const image& a, const image& b)
+{
+  double sum = 0;
+  for (std::size_t k = 0; k < a.pixels.size(); ++k)
+    sum += (a.pixels[k] - b.pixels[k]).length_squared();
+  return sum / (3 * a.pixels.size());
+}
+
+int main(void)
+{
+  // A ring of spheres under a dome, with one column of the ring left
+  // out as the opening
+  hittable_list list;
+  auto wall = std::make_shared<lambertian>(color(0.3, 0.3, 0.3));
+  list.add(std::make_shared<sphere>(point3(0, -1000, 0), 1000, wall));
+  list.add(std::make_shared<sphere>(point3(0, 9, 0), 6, wall));
+  for (int k = 1; k < 12; ++k)
+  {
+    double angle = 2 * pi * k / 12;
+    for (int row = 0; row < 2; ++row)
+      list.add(std::make_shared<sphere>(point3(4.5 * std::cos(angle), 1.4 + 2.8 * row,
+                                               4.5 * std::sin(angle)), 1.45, wall));
+  }
+  list.add(std::make_shared<sphere>(point3(-1.2, 0.5, 0), 0.5,
+                                    std::make_shared<lambertian>(color(0.8, 0.3, 0.2))));
+  list.add(std::make_shared<sphere>(point3(0, 0.5, 0), 0.5,
+                                    std::make_shared<dielectric>(1.5)));
+  list.add(std::make_shared<sphere>(point3(1.2, 0.5, 0), 0.5,
+                                    std::make_shared<metal>(color(0.8, 0.8, 0.8), 0.1)));
+  bvh world(list);
+
+  camera cam;
+  cam.aspect_ratio      = 16.0 / 9.0;
+  cam.image_width       = 160;
+  cam.samples_per_pixel = 64;
+  cam.max_depth         = 16;
+  cam.vfov              = 70;
+  cam.lookfrom          = point3(-1.8, 1.5, 1.8);
+  cam.lookat            = point3(0.5, 0.6, 0);
+
+  thread_pool pool;
+
+  double efficiency[2];
+  for (int guided = 0; guided < 2; ++guided)
+  {
+    cam.path_guiding = guided;
+
+    image first, second;
+    cam.seed = 1;
+    auto start = std::chrono::steady_clock::now();
+    cam.render(world, pool, first);
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    cam.seed = 2;
+    cam.render(world, pool, second);
+
+    auto variance = mse(first, second) / 2;
+    efficiency[guided] = 1 / (variance * time.count());
+
+    std::cout << (guided ? "guided:   " : "unguided: ") << time.count() << "s, variance "
+              << variance << "\n";
+  }
+
+  std::cout << "efficiency ratio " << efficiency[1] / efficiency[0] << "\n";
+  return 0;
+}
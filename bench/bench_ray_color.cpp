@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Renders the scene of main.cpp at a small size and reports the
+// sample throughput. Built twice, as bench_ray_color with the default
+// math and as bench_ray_color_fast with the SIMD vec3 backend and the
+// fast math kernels, compare the two outputs
+
+#include <iostream>
+
+#include "raytracer.hpp"
+#include "common.hpp"
+
+int main(void)
+{
+  hittable_list list;
+  build_scene([&](const point3& center, double radius, std::shared_ptr<material> mat)
+  {
+    list.add(std::make_shared<sphere>(center, radius, mat));
+  });
+  bvh world(list);
+
+  camera cam;
+  cam.aspect_ratio      = 16.0 / 9.0;
+  cam.image_width       = 320;
+  cam.samples_per_pixel = 16;
+  cam.max_depth         = 50;
+  cam.vfov              = 20;
+  cam.lookfrom          = point3(13,2,3);
+  cam.lookat            = point3(0,0,0);
+  cam.defocus_angle     = 0.6;
+  cam.focus_dist        = 10.0;
+
+  thread_pool pool;
+  auto time = time_render(world, cam, pool);
+
+  cam.initialize();
+  double samples = double(cam.image_width) * cam.height() * cam.samples_per_pixel;
+
+  std::cout << "vec3 backend: "
+#ifdef RAYTRACER_VEC3_SIMD
+            << "simd"
+#else
+            << "scalar"
+#endif
+            << ", math: "
+#ifdef RAYTRACER_FAST_MATH
+            << "fast"
+#else
+            << "standard"
+#endif
+            << "\n" << time << "s, " << samples / time / 1e6 << " Msamples/s\n";
+
+  return 0;
+}
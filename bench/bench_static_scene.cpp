@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Compares the virtual hittable_list with the compile-time
+// static_scene on the scene of main.cpp, first on raw intersection
+// queries and then on a full render
+
+#include <iostream>
+
+#include "raytracer.hpp"
+#include "common.hpp"
+
+template <typename World>
+double time_queries(const World& world, const std::vector<ray>& rays, int& hits)
+{
+  return seconds([&]
+  {
+    hit_record rec;
+    hits = 0;
+    for (const auto& r : rays)
+      hits += world.hit(r, interval(0.001, infinity), rec);
+  });
+}
+
+int main(void)
+{
+  hittable_list dynamic_world;
+  static_scene<sphere> static_world;
+  build_scene([&](const point3& center, double radius, std::shared_ptr<material> mat)
+  {
+    dynamic_world.add(std::make_shared<sphere>(center, radius, mat));
+    static_world.add(sphere(center, radius, mat));
+  });
+
+  std::vector<ray> rays;
+  random_seed(1);
+  for (int i = 0; i < 200000; ++i)
+    rays.emplace_back(point3(13, 2, 3), vec3(random_double(-1, 0), random_double(-0.3, 0.1),
+                                             random_double(-0.5, 0.3)));
+
+  int dynamic_hits, static_hits;
+  auto dynamic_queries = time_queries(dynamic_world, rays, dynamic_hits);
+  auto static_queries  = time_queries(static_world, rays, static_hits);
+
+  std::cout << dynamic_world.objects.size() << " spheres, " << rays.size() << " rays\n"
+            << "queries  hittable_list: " << dynamic_queries << "s (" << dynamic_hits << " hits)\n"
+            << "queries  static_scene:  " << static_queries << "s (" << static_hits << " hits), "
+            << dynamic_queries / static_queries << "x\n";
+
+  camera cam;
+  cam.aspect_ratio      = 16.0 / 9.0;
+  cam.image_width       = 320;
+  cam.samples_per_pixel = 8;
+  cam.max_depth         = 50;
+  cam.vfov              = 20;
+  cam.lookfrom          = point3(13,2,3);
+  cam.lookat            = point3(0,0,0);
+  cam.defocus_angle     = 0.6;
+  cam.focus_dist        = 10.0;
+
+  thread_pool pool;
+  auto dynamic_render = time_render(dynamic_world, cam, pool);
+  auto static_render  = time_render(static_world, cam, pool);
+
+  std::cout << "render   hittable_list: " << dynamic_render << "s\n"
+            << "render   static_scene:  " << static_render << "s, "
+            << dynamic_render / static_render << "x\n";
+
+  return 0;
+}
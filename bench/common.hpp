@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Helpers shared by the benchmarks
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include "raytracer.hpp"
+
+// Calls add(center, radius, material) for every sphere of the
+// scene of main.cpp
+template <typename Add>
+void build_scene(Add add)
+{
+  random_seed(0);
+  add(point3(0,-1000,0), 1000, std::make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+
+  for (int a = -11; a < 11; a++)
+  {
+    for (int b = -11; b < 11; b++)
+    {
+      auto choose_mat = random_double();
+      point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+      if ((center - point3(4, 0.2, 0)).length() <= 0.9)
+        continue;
+
+      if (choose_mat < 0.8)
+        add(center, 0.2, std::make_shared<lambertian>(color::random() * color::random()));
+      else if (choose_mat < 0.95)
+        add(center, 0.2, std::make_shared<metal>(color::random(0.5, 1), random_double(0, 0.5)));
+      else
+        add(center, 0.2, std::make_shared<dielectric>(1.5));
+    }
+  }
+
+  add(point3(0, 1, 0), 1.0, std::make_shared<dielectric>(1.5));
+  add(point3(-4, 1, 0), 1.0, std::make_shared<lambertian>(color(0.4, 0.2, 0.1)));
+  add(point3(4, 1, 0), 1.0, std::make_shared<metal>(color(0.7, 0.6, 0.5), 0.0));
+}
+
+// Best time of a few runs of [fn], in seconds
+template <typename Fn>
+double seconds(Fn fn)
+{
+  double best = infinity;
+  for (int run = 0; run < 3; ++run)
+  {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Best time of rendering [world] through [cam], in seconds
+template <typename World>
+double time_render(const World& world, camera cam, thread_pool& pool)
+{
+  cam.initialize();
+  image framebuffer(cam.image_width, cam.height());
+  return seconds([&]
+  {
+    parallel_for(pool, cam.height(), [&](int j)
+    {
+      cam.render_scanline(world, j, framebuffer.row(j));
+    });
+  });
+}
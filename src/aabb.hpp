@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "interval.hpp"
+#include "ray.hpp"
+
+#include <utility>
+
+// Axis-aligned bounding box, the intersection of three intervals
+class aabb
+{
+public:
+  interval x, y, z;
+
+  aabb() {}  // empty by default, since intervals are empty by default
+
+  aabb(const interval& x, const interval& y, const interval& z)
+    : x(x), y(y), z(z) {}
+
+  // Box with [a] and [b] as opposite corners
+  aabb(const point3& a, const point3& b)
+  {
+    x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+    y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+    z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+  }
+
+  // The tightest box enclosing both [box0] and [box1]
+  aabb(const aabb& box0, const aabb& box1)
+    : x(box0.x, box1.x), y(box0.y, box1.y), z(box0.z, box1.z) {}
+
+  const interval& axis_interval(int n) const
+  {
+    if (n == 1) return y;
+    if (n == 2) return z;
+    return x;
+  }
+
+  point3 centroid() const
+  {
+    return point3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max));
+  }
+
+  // Slab test: the ray hits the box if the t intervals in which it
+  // is inside each pair of axis-aligned planes overlap
+  bool hit(const ray& r, interval ray_t) const
+  {
+    const point3& ray_orig = r.origin();
+    const vec3&   ray_dir  = r.direction();
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+      const interval& ax = axis_interval(axis);
+      const double adinv = 1.0 / ray_dir[axis];
+
+      auto t0 = (ax.min - ray_orig[axis]) * adinv;
+      auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+      if (t0 > t1)
+        std::swap(t0, t1);
+      if (t0 > ray_t.min) ray_t.min = t0;
+      if (t1 < ray_t.max) ray_t.max = t1;
+
+      if (ray_t.max <= ray_t.min)
+        return false;
+    }
+    return true;
+  }
+
+  // Returns the index of the longest axis of the bounding box
+  int longest_axis() const
+  {
+    if (x.size() > y.size())
+      return x.size() > z.size() ? 0 : 2;
+    else
+      return y.size() > z.size() ? 1 : 2;
+  }
+
+  static const aabb empty, universe;
+};
+
+inline const aabb aabb::empty    = aabb(interval::empty,    interval::empty,    interval::empty);
+inline const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+
+inline aabb operator+(const aabb& bbox, const vec3& offset)
+{
+  return aabb(bbox.x + offset.x(), bbox.y + offset.y(), bbox.z + offset.z());
+}
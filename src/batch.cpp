@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#include "batch.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+// Rays per task, a multiple of 64 so that no two tasks share a word
+// of the occlusion bits
+constexpr std::size_t rays_per_task = 1024;
+
+ray batch_ray(const ray_batch& rays, std::size_t i)
+{
+  const double* o = rays.origins + 3 * i;
+  const double* d = rays.directions + 3 * i;
+  return ray(point3(o[0], o[1], o[2]), vec3(d[0], d[1], d[2]));
+}
+
+// Calls fn(first, last) for consecutive ranges of the [count] rays on
+// the workers of [pool]
+template <typename Fn>
+void for_each_task(thread_pool& pool, std::size_t count, Fn fn)
+{
+  int tasks = int((count + rays_per_task - 1) / rays_per_task);
+  parallel_for(pool, tasks, [&](int task)
+  {
+    std::size_t first = std::size_t(task) * rays_per_task;
+    fn(first, std::min(count, first + rays_per_task));
+  });
+}
+
+} // namespace
+
+thread_pool& default_thread_pool()
+{
+  static thread_pool pool;
+  return pool;
+}
+
+void intersect_batch(const hittable& world, const ray_batch& rays, const hit_batch& hits,
+                     thread_pool& pool)
+{
+  for_each_task(pool, rays.count, [&](std::size_t first, std::size_t last)
+  {
+    hit_record rec;
+    for (std::size_t i = first; i < last; ++i)
+    {
+      if (!world.hit(batch_ray(rays, i), interval(rays.t_min[i], rays.t_max[i]), rec))
+      {
+        hits.t[i] = infinity;
+        if (hits.primitives)
+          hits.primitives[i] = -1;
+        continue;
+      }
+
+      hits.t[i] = rec.t;
+      if (hits.normals)
+      {
+        vec3 outward = rec.front_face ? rec.normal : -rec.normal;
+        for (int k = 0; k < 3; ++k)
+          hits.normals[3 * i + k] = outward[k];
+      }
+      if (hits.primitives)
+        hits.primitives[i] = rec.primitive;
+    }
+  });
+}
+
+void intersect_batch(const hittable& world, const ray_batch& rays, const hit_batch& hits)
+{
+  intersect_batch(world, rays, hits, default_thread_pool());
+}
+
+void occluded_batch(const hittable& world, const ray_batch& rays, std::uint64_t* occluded,
+                    thread_pool& pool)
+{
+  for_each_task(pool, rays.count, [&](std::size_t first, std::size_t last)
+  {
+    for (std::size_t word = first; word < last; word += 64)
+    {
+      std::uint64_t bits = 0;
+      for (std::size_t i = word; i < std::min(last, word + 64); ++i)
+        if (world.occluded(batch_ray(rays, i), interval(rays.t_min[i], rays.t_max[i])))
+          bits |= std::uint64_t(1) << (i - word);
+      occluded[word / 64] = bits;
+    }
+  });
+}
+
+void occluded_batch(const hittable& world, const ray_batch& rays, std::uint64_t* occluded)
+{
+  occluded_batch(world, rays, occluded, default_thread_pool());
+}
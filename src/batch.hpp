@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "hittable.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// Batch queries
+// -------------
+//
+// Intersects many rays with a scene at once, for the tools that need
+// visibility or collisions without rendering an image. The inputs and
+// outputs are plain arrays, one element per ray, and the rays are
+// split among the workers of a thread pool. Part of the raytracer_core
+// library, link it to use these functions.
+//
+// The scene is any hittable, typically a bvh, whose hit records give
+// the primitive ids.
+//
+
+// Input of a batch of [count] rays. [origins] and [directions] hold x,
+// y, z triples, the directions need not be unit vectors. Ray i looks
+// for hits at distances in (t_min[i], t_max[i]), in units of its
+// direction length
+struct ray_batch
+{
+  const double* origins    = nullptr;
+  const double* directions = nullptr;
+  const double* t_min      = nullptr;
+  const double* t_max      = nullptr;
+  std::size_t   count      = 0;
+};
+
+// Output of intersect_batch(), arrays with one element per ray, or a
+// triple for [normals]. A ray that misses gets t infinity, primitive
+// -1 and its normal is left untouched. The normals are the outward
+// unit normals of the surfaces, whichever side they are hit from.
+// [normals] and [primitives] may be null if they are not needed
+struct hit_batch
+{
+  double*       t          = nullptr;
+  double*       normals    = nullptr;
+  std::int32_t* primitives = nullptr;
+};
+
+// Workers used by the overloads without a pool, created on first use
+thread_pool& default_thread_pool();
+
+// Finds the closest hit of each ray of [rays] in [world]
+void intersect_batch(const hittable& world, const ray_batch& rays, const hit_batch& hits,
+                     thread_pool& pool);
+void intersect_batch(const hittable& world, const ray_batch& rays, const hit_batch& hits);
+
+// Sets bit i % 64 of occluded[i / 64] if ray i hits anything in
+// [world] and clears it otherwise. [occluded] holds (count + 63) / 64
+// words. Stops at the first hit, cheaper than intersect_batch()
+void occluded_batch(const hittable& world, const ray_batch& rays, std::uint64_t* occluded,
+                    thread_pool& pool);
+void occluded_batch(const hittable& world, const ray_batch& rays, std::uint64_t* occluded);
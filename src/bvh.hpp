@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+#include "hittable_list.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// Bounding volume hierarchy
+//
+// The objects are grouped in a binary tree of bounding boxes, a ray
+// only tests the objects whose boxes it crosses. The nodes are stored
+// flat in depth-first order, so the children of a node always come
+// after it. This lets refit() update all the boxes in one backward
+// pass when the objects move, without rebuilding the tree.
+//
+// The primitive of a hit is the index of the object in the list the
+// tree was built from.
+class bvh : public hittable
+{
+public:
+
+  bvh(const hittable_list& list) : bvh(list.objects) {}
+
+  bvh(const std::vector<std::shared_ptr<hittable>>& list)
+  {
+    objects.reserve(list.size());
+    for (std::size_t i = 0; i < list.size(); ++i)
+      objects.push_back({ list[i], int(i) });
+    rebuild();
+  }
+
+  bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+  {
+    if (nodes.empty())
+      return false;
+
+    bool hit_anything = false;
+    int  stack[64];
+    int  stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+      const node& n = nodes[stack[--stack_size]];
+      if (!n.bbox.hit(r, ray_t))
+        continue;
+
+      if (n.count > 0)
+      {
+        for (int i = n.first; i < n.first + n.count; ++i)
+        {
+          if (objects[i].object->hit(r, ray_t, rec))
+          {
+            hit_anything = true;
+            ray_t.max = rec.t;
+            rec.primitive = objects[i].id;
+          }
+        }
+        continue;
+      }
+
+      // Visit first the child on the side the ray comes from
+      int left  = int(&n - nodes.data()) + 1;
+      int right = n.first;
+      if (r.direction()[n.axis] < 0)
+        std::swap(left, right);
+      stack[stack_size++] = right;
+      stack[stack_size++] = left;
+    }
+
+    return hit_anything;
+  }
+
+  bool occluded(const ray& r, interval ray_t) const override
+  {
+    if (nodes.empty())
+      return false;
+
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+      int index = stack[--stack_size];
+      const node& n = nodes[index];
+      if (!n.bbox.hit(r, ray_t))
+        continue;
+
+      if (n.count > 0)
+      {
+        for (int i = n.first; i < n.first + n.count; ++i)
+          if (objects[i].object->occluded(r, ray_t))
+            return true;
+        continue;
+      }
+
+      stack[stack_size++] = n.first;
+      stack[stack_size++] = index + 1;
+    }
+
+    return false;
+  }
+
+  aabb bounding_box() const override
+  {
+    return nodes.empty() ? aabb::empty : nodes[0].bbox;
+  }
+
+  // Rebuilds the tree from scratch
+  void rebuild()
+  {
+    nodes.clear();
+    nodes.reserve(2 * objects.size());
+    if (!objects.empty())
+      build(0, int(objects.size()));
+  }
+
+  // Recomputes the boxes of all the nodes from the current bounds of
+  // the objects, keeping the tree topology. This is much cheaper than
+  // rebuild() and works well as long as the objects move coherently;
+  // rebuild if the quality of the tree degrades
+  void refit()
+  {
+    for (int i = int(nodes.size()) - 1; i >= 0; --i)
+    {
+      node& n = nodes[i];
+      if (n.count > 0)
+      {
+        n.bbox = aabb::empty;
+        for (int k = n.first; k < n.first + n.count; ++k)
+          n.bbox = aabb(n.bbox, objects[k].object->bounding_box());
+      }
+      else
+      {
+        n.bbox = aabb(nodes[i + 1].bbox, nodes[n.first].bbox);
+      }
+    }
+  }
+
+private:
+
+  // Leaves have count > 0 and hold objects[first, first + count).
+  // Inner nodes have their left child right after them and the
+  // right child at index first
+  struct node
+  {
+    aabb bbox;
+    int  first = 0;
+    int  count = 0;
+    int  axis  = 0;  // split axis of an inner node
+  };
+
+  // An object and its index in the list the tree was built from
+  struct primitive
+  {
+    std::shared_ptr<hittable> object;
+    int id;
+  };
+
+  static constexpr int max_leaf_size = 2;
+
+  std::vector<primitive> objects;
+  std::vector<node> nodes;
+
+  // Builds the subtree over objects[start, end) and returns the index
+  // of its root
+  int build(int start, int end)
+  {
+    int index = int(nodes.size());
+    nodes.emplace_back();
+
+    aabb bbox = aabb::empty;
+    for (int i = start; i < end; ++i)
+      bbox = aabb(bbox, objects[i].object->bounding_box());
+
+    if (end - start <= max_leaf_size)
+    {
+      nodes[index].bbox  = bbox;
+      nodes[index].first = start;
+      nodes[index].count = end - start;
+      return index;
+    }
+
+    // Split at the median of the centroids along the longest axis
+    aabb centroids = aabb::empty;
+    for (int i = start; i < end; ++i)
+    {
+      auto c = objects[i].object->bounding_box().centroid();
+      centroids = aabb(centroids, aabb(c, c));
+    }
+    int axis = centroids.longest_axis();
+
+    int mid = start + (end - start) / 2;
+    std::nth_element(objects.begin() + start, objects.begin() + mid,
+                     objects.begin() + end,
+                     [axis](const auto& a, const auto& b)
+                     {
+                       return a.object->bounding_box().centroid()[axis]
+                         < b.object->bounding_box().centroid()[axis];
+                     });
+
+    build(start, mid);
+    int right = build(mid, end);
+
+    nodes[index].bbox  = bbox;
+    nodes[index].first = right;
+    nodes[index].axis  = axis;
+    return index;
+  }
+};
@@ -5,8 +5,17 @@
 
 #pragma once
 
+#include "guiding.hpp"
 #include "hittable.hpp"
 #include "material.hpp"
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class camera {
 public:
@@ -24,45 +33,75 @@ public:
   double defocus_angle = 0;  // Variation angle of rays through each pixel
   double focus_dist    = 10; // Distance from camera lookfrom point to plane of perfect focus
 
-  // Render to PBM format, writes to standard output
-  void render(const hittable& world)
+  std::uint32_t seed = 0;  // base of the per-scanline random streams
+
+  // Path guiding, see guiding.hpp. Only render() trains a guide
+  bool   path_guiding      = false;
+  double guiding_training  = 0.25;  // fraction of the samples spent training
+
+  // Render to PBM format, writes to standard output.
+  //
+  // The world is any type with a hittable-like hit() method, either a
+  // hittable or a closed world such as static_scene, for which the
+  // whole path down to the primitives is compiled without virtual
+  // calls
+  template <typename World>
+  void render(const World& world)
   {
-    initialize();
+    thread_pool pool;
+    render(world, pool);
+  }
 
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+  // Render to PBM format using the workers of [pool], writes to
+  // standard output
+  template <typename World>
+  void render(const World& world, thread_pool& pool)
+  {
+    initialize();
 
-    for (int j = 0; j < image_height; ++j)
+    image framebuffer(image_width, image_height);
+    if (path_guiding)
     {
-      std::clog << "\rScanlines remaining: " << (image_height - j) << "\n" << std::flush; 
-      for (int i = 0; i < image_width; ++i)
+      render_guided(world, pool, framebuffer, true);
+    }
+    else
+    {
+      std::mutex progress_mutex;
+      int remaining = image_height;
+
+      parallel_for(pool, image_height, [&](int j)
       {
-        color pixel_color(0, 0, 0);
-        for (int sample = 0; sample < samples_per_pixel; sample++)
-        {
-          ray r = get_ray(i, j);
-          pixel_color += ray_color(r, max_depth, world);
-        }
-        
-        write_color(std::cout, pixel_samples_scale * pixel_color);
-      }
+        render_scanline(world, j, framebuffer.row(j));
+
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        std::clog << "\rScanlines remaining: " << --remaining << "\n" << std::flush;
+      });
     }
 
+    framebuffer.write_ppm(std::cout);
+
     std::clog << "\rDone.             \n";
-  
   }
 
-private:
+  // Renders into [framebuffer], sized to the image, without writing it
+  // out or reporting progress
+  template <typename World>
+  void render(const World& world, thread_pool& pool, image& framebuffer)
+  {
+    initialize();
 
-  int    image_height;
-  point3 center;
-  point3 pixel00_loc;      // location of pixel 00
-  vec3   pixel_delta_u;    // offset to pixel to the right
-  vec3   pixel_delta_v;    // offset to pixel below
-  double pixel_samples_scale;  // color scale factor for a sum of pixel samples
-  vec3   u, v, w;          // Camera frame basis vectors
-  vec3   defocus_disk_u;   // Defocus disk horizontal radius
-  vec3   defocus_disk_v;   // Defocus disk vertical radius
-  
+    framebuffer = image(image_width, image_height);
+    if (path_guiding)
+      render_guided(world, pool, framebuffer, false);
+    else
+      parallel_for(pool, image_height, [&](int j)
+      {
+        render_scanline(world, j, framebuffer.row(j));
+      });
+  }
+
+  // Sets up the camera frame from the public parameters. Called by
+  // render, call it explicitly before using the accessors below
   void initialize()
   {
     //
@@ -121,8 +160,115 @@ private:
     auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle / 2));
     defocus_disk_u = u * defocus_radius;
     defocus_disk_v = v * defocus_radius;
+
+    // Angle covered by a pixel seen from the camera
+    pixel_spread = pixel_delta_u.length() / focus_dist;
+  }
+
+  // Values computed by initialize()
+  int height() const           { return image_height; }
+  const vec3& right() const    { return u; }
+  const vec3& up() const       { return v; }
+  const vec3& backward() const { return w; }
+
+  // Renders row [j] of the image into [row], which holds
+  // image_width linear colors. The camera must be initialized
+  template <typename World>
+  void render_scanline(const World& world, int j, color* row) const
+  {
+    render_span(world, j, 0, image_width, row);
+  }
+
+  // Renders the pixels [i0, i1) of row [j] into [out]. Each span has
+  // its own random stream, so the result does not depend on the
+  // order in which spans are rendered
+  template <typename World>
+  void render_span(const World& world, int j, int i0, int i1, color* out) const
+  {
+    random_seed(seed ^ (0x9E3779B9u * std::uint32_t(j + 1)) ^ (0x85EBCA6Bu * std::uint32_t(i0)));
+
+    for (int i = i0; i < i1; ++i)
+    {
+      color pixel_color(0, 0, 0);
+      for (int sample = 0; sample < samples_per_pixel; sample++)
+      {
+        ray r = get_ray(i, j);
+        pixel_color += ray_color(r, max_depth, world);
+      }
+
+      out[i - i0] = pixel_samples_scale * pixel_color;
+    }
   }
 
+private:
+
+  int    image_height = 0;
+  point3 center;
+  point3 pixel00_loc;      // location of pixel 00
+  vec3   pixel_delta_u;    // offset to pixel to the right
+  vec3   pixel_delta_v;    // offset to pixel below
+  double pixel_samples_scale = 1;  // color scale factor for a sum of pixel samples
+  vec3   u, v, w;          // Camera frame basis vectors
+  vec3   defocus_disk_u;   // Defocus disk horizontal radius
+  vec3   defocus_disk_v;   // Defocus disk vertical radius
+  double pixel_spread = 0; // Cone angle of the camera rays
+
+  // Guide of the current pass, if any. Sampled once trained, recorded
+  // into during the training passes
+  std::shared_ptr<path_guide> guide;
+  bool guide_sampling  = false;
+  bool guide_recording = false;
+
+  // Probability of following the guide instead of the material
+  static constexpr double guide_fraction = 0.5;
+
+  // Renders in passes of 1, 2, 4... samples per pixel, refining the
+  // guide after each one until [guiding_training] of the samples are
+  // spent, then the remaining samples with the guide frozen. Every
+  // pass is unbiased, so all of them are averaged into the image
+  template <typename World>
+  void render_guided(const World& world, thread_pool& pool, image& framebuffer,
+                     bool report_progress) const
+  {
+    auto trained_guide = std::make_shared<path_guide>();
+    int training = std::max(1, int(guiding_training * samples_per_pixel));
+
+    int done = 0;
+    for (int pass_index = 0, pass_samples = 1; done < samples_per_pixel; ++pass_index, pass_samples *= 2)
+    {
+      bool training_pass = done < training;
+      int  count = training_pass ? std::min(pass_samples, training - done)
+                                 : samples_per_pixel - done;
+
+      camera pass = *this;
+      pass.samples_per_pixel = count;
+      pass.seed = seed ^ (0x68E31DA4u * std::uint32_t(pass_index));
+      pass.initialize();
+      pass.guide           = trained_guide;
+      pass.guide_sampling  = trained_guide->trained();
+      pass.guide_recording = training_pass;
+
+      if (report_progress)
+        std::clog << "\rGuiding pass " << pass_index << ": " << count
+                  << (training_pass ? " samples, training\n" : " samples\n") << std::flush;
+
+      parallel_for(pool, image_height, [&](int j)
+      {
+        std::vector<color> row(image_width);
+        pass.render_scanline(world, j, row.data());
+        for (int i = 0; i < image_width; ++i)
+          framebuffer.row(j)[i] += count * row[i];
+      });
+
+      if (training_pass)
+        trained_guide->refine(count);
+      done += count;
+    }
+
+    for (auto& pixel : framebuffer.pixels)
+      pixel *= pixel_samples_scale;
+  }
+  
   ray get_ray(int i, int j) const
   {
     // Construct a camera ray originating from the defocus disk and
@@ -137,7 +283,7 @@ private:
     auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
     auto ray_direction = pixel_sample - ray_origin;
 
-    return ray(ray_origin, ray_direction);
+    return ray(ray_origin, ray_direction, pixel_spread);
   }
 
   // Returns the vector to a random point in the [-.5,-.5]-[+.5,+.5]
@@ -154,7 +300,8 @@ private:
     return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
   }
   
-  color ray_color(const ray& r, int depth, const hittable& world) const
+  template <typename World>
+  color ray_color(const ray& r, int depth, const World& world) const
   {
     if (depth <= 0) // limit recursion
       return color(0, 0, 0);
@@ -165,9 +312,12 @@ private:
     {
       ray scattered;
       color attenuation;
-      if (rec.mat->scatter(r, rec, attenuation, scattered))
-        return attenuation * ray_color(scattered, depth-1, world);
-      return color(0, 0, 0);
+      if (!rec.mat->scatter(r, rec, attenuation, scattered))
+        return color(0, 0, 0);
+
+      if (guide && rec.mat->scattering_pdf(r, rec, scattered) > 0)
+        return guided_color(r, rec, attenuation, scattered, depth, world);
+      return attenuation * ray_color(scattered, depth-1, world);
     }
 
     // Blend white and blue depending on the height of y (after
@@ -177,4 +327,36 @@ private:
     // Here we are basically doing linear interpolation
     return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
   }
+
+  // One sample MIS between the material and the guide: the direction
+  // follows either of them, picked at random, and is weighted by the
+  // density of their mixture. The attenuation of the material must not
+  // depend on the direction, as for lambertian
+  template <typename World>
+  color guided_color(const ray& r, const hit_record& rec, const color& attenuation,
+                     ray scattered, int depth, const World& world) const
+  {
+    double guide_pdf = 0;
+    if (guide_sampling && random_double() < guide_fraction)
+      scattered = ray(rec.p, guide->sample(rec.p, rec.normal, guide_pdf), scattered.spread());
+    else if (guide_sampling)
+      guide_pdf = guide->pdf(rec.p, rec.normal, unit_vector(scattered.direction()));
+
+    auto material_pdf = rec.mat->scattering_pdf(r, rec, scattered);
+    if (material_pdf <= 0)  // the guide went below the surface
+      return color(0, 0, 0);
+
+    auto pdf = guide_sampling
+      ? guide_fraction * guide_pdf + (1 - guide_fraction) * material_pdf
+      : material_pdf;
+
+    // The guide learns the cosine weighted light, that the material
+    // density is proportional to
+    color incoming = ray_color(scattered, depth-1, world);
+    if (guide_recording)
+      guide->record(rec.p, rec.normal, unit_vector(scattered.direction()),
+                    luminance(incoming) * material_pdf / pdf);
+
+    return attenuation * incoming * (material_pdf / pdf);
+  }
 };
@@ -24,8 +24,14 @@ inline double linear_to_gamma(double linear_component)
   return 0;
 }
 
+// Perceived brightness of a linear color (Rec. 709 weights)
+inline double luminance(const color& c)
+{
+  return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
 // Output a single color to [out] in gamma space RGB
-void write_color(std::ostream& out, const color& pixel_color)
+inline void write_color(std::ostream& out, const color& pixel_color)
 {
   auto r = pixel_color.x();
   auto g = pixel_color.y();
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+//
+// Fast math
+// ---------
+//
+// Cheaper replacements of standard math functions for the hot paths
+// of the renderer. The error bounds below are the largest errors
+// measured over their sample ranges, test_fast_math checks them and
+// bench_fast_math times the kernels. The renderer uses the
+// approximations when it is built with RAYTRACER_FAST_MATH (cmake
+// -DENABLE_FAST_MATH=ON), except for ipow which is as accurate as the
+// multiplications it expands to and is always used.
+//
+
+// x to the integer power N, expanded at compile time into about
+// log2(N) multiplications. Relative error < 1e-15 for N <= 5
+template <unsigned N>
+constexpr double ipow(double x)
+{
+  if constexpr (N == 0)
+    return 1.0;
+  else if constexpr (N % 2 == 0)
+    return ipow<N / 2>(x * x);
+  else
+    return x * ipow<N - 1>(x);
+}
+
+// 1 / sqrt(x) for normal positive x. A bit level initial guess is
+// refined by three Newton steps, each of them doubles the number of
+// correct bits. Relative error < 5e-11
+inline double fast_rsqrt(double x)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5FE6EB50C7B537A9ull - (bits >> 1);
+  double y;
+  std::memcpy(&y, &bits, sizeof(y));
+
+  const double half_x = 0.5 * x;
+  y = y * (1.5 - half_x * y * y);
+  y = y * (1.5 - half_x * y * y);
+  y = y * (1.5 - half_x * y * y);
+  return y;
+}
+
+// Sine and cosine of [x] together. The angle is reduced to
+// [-pi/4, pi/4] and the quadrant, then both are evaluated with a
+// polynomial. Absolute error < 2e-10 for |x| <= 1e3
+inline void fast_sincos(double x, double& s, double& c)
+{
+  constexpr double two_over_pi = 0.63661977236758134308;
+  // pi/2 split in two, the first part has few bits so that k * pi_2_hi
+  // is exact for the quadrants of interest
+  constexpr double pi_2_hi = 1.5707963267341256;
+  constexpr double pi_2_lo = 6.0771005065061922e-11;
+
+  double k = x * two_over_pi;
+  k = double(std::int64_t(k >= 0 ? k + 0.5 : k - 0.5));
+  const double r  = (x - k * pi_2_hi) - k * pi_2_lo;
+  const double r2 = r * r;
+
+  const double sin_r = r * (1 + r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040
+                       + r2 * (1.0 / 362880 + r2 * (-1.0 / 39916800))))));
+  const double cos_r = 1 + r2 * (-0.5 + r2 * (1.0 / 24 + r2 * (-1.0 / 720
+                       + r2 * (1.0 / 40320 + r2 * (-1.0 / 3628800)))));
+
+  switch (std::int64_t(k) & 3)
+  {
+    case 0:  s =  sin_r; c =  cos_r; break;
+    case 1:  s =  cos_r; c = -sin_r; break;
+    case 2:  s = -sin_r; c = -cos_r; break;
+    default: s = -cos_r; c =  sin_r; break;
+  }
+}
+
+// Tangent of [x], away from the poles. Relative error < 5e-10 for
+// |x| <= 1.5, the range of the camera field of view angles
+inline double fast_tan(double x)
+{
+  double s, c;
+  fast_sincos(x, s, c);
+  return s / c;
+}
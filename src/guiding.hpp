@@ -0,0 +1,433 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "aabb.hpp"
+#include "utils.hpp"
+#include "vec3.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//
+// Path guiding
+// ------------
+//
+// Learns, while rendering, from which directions light arrives at
+// each region of the scene, so that diffuse bounces can be sent
+// where the light is instead of only following the cosine. This is
+// a simplified version of "Practical Path Guiding for Efficient
+// Light-Transport Simulation" (Müller et al. 2017).
+//
+// Space is split by a binary tree (spatial tree) whose leaves own
+// quadtrees over the sphere of directions (directional trees), one
+// for each orientation of the surfaces. The render runs in passes of
+// doubling sample counts: during a pass the trees are sampled as
+// learned by the previous passes, read-only, and the light found by
+// the paths is recorded with atomic additions. Between passes
+// refine() rebuilds the trees from what was recorded, subdividing the
+// regions and directions that received the most energy.
+//
+// Unlike the paper, the records are weighted by the cosine with the
+// surface normal, so that each directional tree learns the product
+// that a diffuse bounce integrates rather than the radiance alone.
+//
+
+// Floating point read-modify-write, lock free
+
+inline void atomic_add(std::atomic<double>& target, double value)
+{
+  double current = target.load(std::memory_order_relaxed);
+  while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+    ;
+}
+
+inline void atomic_min(std::atomic<double>& target, double value)
+{
+  double current = target.load(std::memory_order_relaxed);
+  while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    ;
+}
+
+inline void atomic_max(std::atomic<double>& target, double value)
+{
+  double current = target.load(std::memory_order_relaxed);
+  while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    ;
+}
+
+// Quadtree over the unit square, mapped to directions with the
+// cylindrical (equal area) mapping
+class directional_tree
+{
+public:
+
+  directional_tree() : nodes(1), recorded(new std::atomic<double>[4]())
+  {
+    for (int q = 0; q < 4; ++q)
+      nodes[0].energy[q] = 0.25;
+  }
+
+  directional_tree(const directional_tree& other)
+    : nodes(other.nodes), recorded(new std::atomic<double>[4 * other.nodes.size()]())
+  {
+    for (std::size_t k = 0; k < 4 * nodes.size(); ++k)
+      recorded[k] = other.recorded[k].load(std::memory_order_relaxed);
+    samples = other.samples.load(std::memory_order_relaxed);
+  }
+
+  directional_tree& operator=(const directional_tree&) = delete;
+
+  std::uint64_t sample_count() const { return samples.load(std::memory_order_relaxed); }
+
+  // Adds [value] to the quadrant holding [p], thread safe
+  void record(double x, double y, double value)
+  {
+    samples.fetch_add(1, std::memory_order_relaxed);
+    std::uint32_t n = 0;
+    while (true)
+    {
+      int q = quadrant(x, y);
+      if (nodes[n].child[q] == 0)
+      {
+        atomic_add(recorded[4 * n + q], value);
+        return;
+      }
+      n = nodes[n].child[q];
+    }
+  }
+
+  // Picks a point of the unit square with a density proportional to
+  // the learned energy, returns that density
+  double sample(double& x, double& y) const
+  {
+    double pdf = 1;
+    double size = 1, ox = 0, oy = 0;
+    std::uint32_t n = 0;
+    while (true)
+    {
+      const auto& node = nodes[n];
+      double total = node.energy[0] + node.energy[1] + node.energy[2] + node.energy[3];
+      double u = random_double() * total;
+      int q = 0;
+      while (q < 3 && u >= node.energy[q])
+        u -= node.energy[q++];
+
+      pdf *= 4 * node.energy[q] / total;
+      size *= 0.5;
+      ox += (q & 1) ? size : 0;
+      oy += (q & 2) ? size : 0;
+
+      if (node.child[q] == 0)
+        break;
+      n = node.child[q];
+    }
+    x = ox + random_double() * size;
+    y = oy + random_double() * size;
+    return pdf;
+  }
+
+  // Density of sample() at ([x], [y])
+  double pdf(double x, double y) const
+  {
+    double pdf = 1;
+    std::uint32_t n = 0;
+    while (true)
+    {
+      const auto& node = nodes[n];
+      double total = node.energy[0] + node.energy[1] + node.energy[2] + node.energy[3];
+      int q = quadrant(x, y);
+      pdf *= 4 * node.energy[q] / total;
+      if (node.child[q] == 0)
+        return pdf;
+      n = node.child[q];
+    }
+  }
+
+  // Rebuilds the tree from the recorded energy and clears the records.
+  // Quadrants holding more than [threshold] of the total energy are
+  // subdivided, the others are merged. Without records the learned
+  // distribution is kept
+  void refine(double threshold = 0.01, int max_depth = 20)
+  {
+    std::vector<double> sums(4 * nodes.size());
+    double total = subtree_sums(0, sums);
+    if (total > 0)
+    {
+      std::vector<node> refined(1);
+      build(refined, 0, 0, sums, total, threshold, max_depth, 1);
+      nodes = std::move(refined);
+    }
+
+    recorded.reset(new std::atomic<double>[4 * nodes.size()]());
+    samples = 0;
+  }
+
+private:
+
+  struct node
+  {
+    double        energy[4] = { 0, 0, 0, 0 };  // learned energy of each quadrant
+    std::uint32_t child[4]  = { 0, 0, 0, 0 };  // 0 for leaf quadrants
+  };
+
+  std::vector<node> nodes;
+  std::unique_ptr<std::atomic<double>[]> recorded;  // 4 per node, leaf quadrants only
+  std::atomic<std::uint64_t> samples{0};
+
+  // Quadrant of ([x], [y]) and ([x], [y]) remapped into it
+  static int quadrant(double& x, double& y)
+  {
+    int q = 0;
+    x *= 2;
+    y *= 2;
+    if (x >= 1) { q |= 1; x -= 1; }
+    if (y >= 1) { q |= 2; y -= 1; }
+    return q;
+  }
+
+  // Fills [sums] with the recorded energy of each quadrant of the
+  // subtree of [n] and returns their total
+  double subtree_sums(std::uint32_t n, std::vector<double>& sums) const
+  {
+    double total = 0;
+    for (int q = 0; q < 4; ++q)
+    {
+      auto k = 4 * n + q;
+      sums[k] = nodes[n].child[q] ? subtree_sums(nodes[n].child[q], sums)
+                                  : recorded[k].load(std::memory_order_relaxed);
+      total += sums[k];
+    }
+    return total;
+  }
+
+  // Builds node [target] of [refined] from node [n] of the current
+  // tree or, when [leaf_energy] is given, from a leaf quadrant holding
+  // that energy, split evenly
+  void build(std::vector<node>& refined, std::uint32_t target, std::uint32_t n,
+             const std::vector<double>& sums, double total, double threshold,
+             int max_depth, int depth, double leaf_energy = -1) const
+  {
+    for (int q = 0; q < 4; ++q)
+    {
+      double energy = (leaf_energy >= 0) ? leaf_energy / 4 : sums[4 * n + q];
+      // Keep every direction reachable
+      refined[target].energy[q] = std::max(energy, 1e-3 * total / std::pow(4.0, depth));
+
+      if (depth >= max_depth || energy <= threshold * total)
+        continue;
+
+      auto child = std::uint32_t(refined.size());
+      refined.emplace_back();
+      refined[target].child[q] = child;
+
+      if (leaf_energy < 0 && nodes[n].child[q])
+        build(refined, child, nodes[n].child[q], sums, total, threshold, max_depth, depth + 1);
+      else
+        build(refined, child, 0, sums, total, threshold, max_depth, depth + 1, energy);
+    }
+  }
+};
+
+class path_guide
+{
+public:
+
+  path_guide() : nodes(1), leaves(1) {}
+
+  // Whether refine() has been called, before that the guide has
+  // nothing to offer
+  bool trained() const { return iterations > 0; }
+
+  // Samples a unit direction at [p], on a surface facing [normal],
+  // following the light learned around [p], returns its solid angle
+  // density
+  vec3 sample(const point3& p, const vec3& normal, double& pdf) const
+  {
+    double x, y;
+    pdf = leaves[leaf_at(p)].trees[orientation(normal)].sample(x, y) / (4 * pi);
+    return square_to_direction(x, y);
+  }
+
+  // Density of sample() at [p] for the unit vector [direction]
+  double pdf(const point3& p, const vec3& normal, const vec3& direction) const
+  {
+    double x, y;
+    direction_to_square(direction, x, y);
+    return leaves[leaf_at(p)].trees[orientation(normal)].pdf(x, y) / (4 * pi);
+  }
+
+  // Records [value], the light arriving at [p], on a surface facing
+  // [normal], from the unit vector [direction], over the density it
+  // was sampled with. Thread safe
+  void record(const point3& p, const vec3& normal, const vec3& direction, double value)
+  {
+    if (!(value >= 0) || std::isinf(value))
+      return;
+    double x, y;
+    direction_to_square(direction, x, y);
+    auto& target = leaves[leaf_at(p)];
+    target.trees[orientation(normal)].record(x, y, value);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      atomic_min(target.min[axis], p[axis]);
+      atomic_max(target.max[axis], p[axis]);
+    }
+  }
+
+  // Learns from the samples recorded since the last call. Not thread
+  // safe, call it between render passes. [pass_samples] is the number
+  // of samples per pixel of the pass that was recorded, the spatial
+  // tree is split where it collected many samples for that budget
+  void refine(int pass_samples)
+  {
+    const double split_threshold = spatial_threshold * std::sqrt(double(pass_samples));
+
+    // Leaves to split, with their samples and the bounds of the points
+    // they were recorded at
+    struct candidate { std::uint32_t node; double samples; aabb bounds; };
+    std::vector<candidate> candidates;
+    for (std::uint32_t n = 0; n < nodes.size(); ++n)
+    {
+      if (nodes[n].child != 0)
+        continue;
+      auto& l = leaves[nodes[n].leaf];
+      double samples = 0;
+      for (const auto& tree : l.trees)
+        samples += double(tree.sample_count());
+      if (samples > split_threshold)
+        candidates.push_back({ n, samples, aabb(point3(l.min[0], l.min[1], l.min[2]),
+                                                point3(l.max[0], l.max[1], l.max[2])) });
+    }
+
+    for (auto& l : leaves)
+      l.refine();
+
+    // Split at the middle of the recorded points, along their longest
+    // extent, until each part would have collected fewer samples than
+    // the threshold, assuming they halve at every split. Both halves
+    // start from the directional tree of their parent
+    while (!candidates.empty())
+    {
+      auto c = candidates.back();
+      candidates.pop_back();
+      if (c.samples <= split_threshold || nodes[c.node].depth >= max_spatial_depth)
+        continue;
+
+      int axis = c.bounds.longest_axis();
+      const interval& extent = c.bounds.axis_interval(axis);
+      double split = 0.5 * (extent.min + extent.max);
+
+      auto left  = std::uint32_t(nodes.size());
+      int  depth = nodes[c.node].depth + 1;
+      leaves.push_back(leaf(leaves[nodes[c.node].leaf]));
+      nodes.push_back({ 0, 0, 0, nodes[c.node].leaf, depth });
+      nodes.push_back({ 0, 0, 0, std::uint32_t(leaves.size() - 1), depth });
+      nodes[c.node] = { axis, split, left, 0, depth - 1 };
+
+      aabb lower = c.bounds, upper = c.bounds;
+      interval& lower_extent = axis == 0 ? lower.x : axis == 1 ? lower.y : lower.z;
+      interval& upper_extent = axis == 0 ? upper.x : axis == 1 ? upper.y : upper.z;
+      lower_extent.max = upper_extent.min = split;
+      candidates.push_back({ left, c.samples / 2, lower });
+      candidates.push_back({ left + 1, c.samples / 2, upper });
+    }
+    ++iterations;
+  }
+
+private:
+
+  // Inner nodes split space at [split] along [axis], their children
+  // are [child] and [child] + 1
+  struct spatial_node
+  {
+    int           axis  = 0;
+    double        split = 0;
+    std::uint32_t child = 0;  // 0 for leaves
+    std::uint32_t leaf  = 0;  // index in leaves
+    int           depth = 0;
+  };
+
+  // Directional trees of a spatial leaf, one per orientation(), with
+  // the bounds of the points recorded into them
+  struct leaf
+  {
+    directional_tree trees[6];
+    std::atomic<double> min[3] = { {infinity}, {infinity}, {infinity} };
+    std::atomic<double> max[3] = { {-infinity}, {-infinity}, {-infinity} };
+
+    leaf() = default;
+
+    leaf(const leaf& other)
+      : trees{ other.trees[0], other.trees[1], other.trees[2],
+               other.trees[3], other.trees[4], other.trees[5] } {}
+
+    void refine()
+    {
+      for (auto& tree : trees)
+        tree.refine();
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        min[axis] = infinity;
+        max[axis] = -infinity;
+      }
+    }
+  };
+
+  // Samples a leaf may collect in a pass of one sample per pixel
+  // before it is split, from the paper
+  static constexpr double spatial_threshold = 12000;
+  static constexpr int    max_spatial_depth = 48;
+
+  std::vector<spatial_node> nodes;
+  std::vector<leaf>         leaves;
+  int iterations = 0;
+
+  // Dominant axis and sign of [normal]. Surfaces facing different
+  // ways see different halves of the sphere, so they do not share a
+  // directional tree even in the same spatial leaf
+  static int orientation(const vec3& normal)
+  {
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+      if (std::fabs(normal[k]) > std::fabs(normal[axis]))
+        axis = k;
+    return 2 * axis + (normal[axis] < 0 ? 1 : 0);
+  }
+
+  std::uint32_t leaf_at(const point3& p) const
+  {
+    std::uint32_t n = 0;
+    while (nodes[n].child != 0)
+      n = nodes[n].child + (p[nodes[n].axis] < nodes[n].split ? 0 : 1);
+    return nodes[n].leaf;
+  }
+
+  // Cylindrical mapping, x is the cosine of the polar angle and y the
+  // azimuth. It preserves areas, so densities only differ by 4 pi
+  static vec3 square_to_direction(double x, double y)
+  {
+    double cos_theta = 2 * x - 1;
+    double sin_theta = std::sqrt(std::fmax(0.0, 1 - cos_theta * cos_theta));
+    double phi = 2 * pi * y;
+    return vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+  }
+
+  static void direction_to_square(const vec3& d, double& x, double& y)
+  {
+    x = interval(0, 1).clamp(0.5 * (d.z() + 1));
+    double phi = std::atan2(d.y(), d.x());
+    if (phi < 0)
+      phi += 2 * pi;
+    y = interval(0, 1).clamp(phi / (2 * pi));
+    // Stay inside the half open square
+    if (x >= 1) x = std::nextafter(1.0, 0.0);
+    if (y >= 1) y = std::nextafter(1.0, 0.0);
+  }
+};
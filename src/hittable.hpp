@@ -7,6 +7,7 @@
 
 #include "ray.hpp"
 #include "interval.hpp"
+#include "aabb.hpp"
 
 #include <memory>
 
@@ -22,6 +23,10 @@ public:
   double t;
   bool   front_face;
   std::shared_ptr<material> mat;
+  double u, v;            // surface coordinates of the hit point
+  double footprint = 0;   // width of the ray cone at the hit, in uv units
+  int    primitive = -1;  // index of the hit object in the outermost
+                          // container, see hittable_list and bvh
 
   // Sets the hit record normal vector.
   // NOTE: the parameter `outward_normal` is assumed to have unit length.
@@ -39,4 +44,153 @@ public:
 
   // Fills [rec] with hit information
   virtual bool hit(const ray& t, interval ray_t, hit_record& rec) const = 0;
+
+  // Box enclosing the object, used by acceleration structures
+  virtual aabb bounding_box() const = 0;
+
+  // Whether anything is hit in [ray_t]. Unlike hit() any hit will do,
+  // so containers stop at the first one they find
+  virtual bool occluded(const ray& r, interval ray_t) const
+  {
+    hit_record rec;
+    return hit(r, ray_t, rec);
+  }
+};
+
+// Moves an object by [offset]. Instead of moving the object, the ray
+// is moved in the opposite direction and the hit point moved back.
+// The offset can be changed between renders to animate the object
+class translate : public hittable
+{
+public:
+
+  translate(std::shared_ptr<hittable> object, const vec3& offset)
+    : object(object), offset(offset)
+  {
+    bbox = object->bounding_box() + offset;
+  }
+
+  bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+  {
+    ray offset_r(r.origin() - offset, r.direction(), r.spread());
+
+    if (!object->hit(offset_r, ray_t, rec))
+      return false;
+
+    rec.p += offset;
+    return true;
+  }
+
+  bool occluded(const ray& r, interval ray_t) const override
+  {
+    return object->occluded(ray(r.origin() - offset, r.direction(), r.spread()), ray_t);
+  }
+
+  aabb bounding_box() const override { return bbox; }
+
+  const vec3& get_offset() const { return offset; }
+
+  void set_offset(const vec3& new_offset)
+  {
+    offset = new_offset;
+    bbox   = object->bounding_box() + offset;
+  }
+
+private:
+
+  std::shared_ptr<hittable> object;
+  vec3 offset;
+  aabb bbox;
+};
+
+// Places an object with a scale along each axis, then a rotation of
+// [rotation] degrees about the x, y and z axes in this order, then
+// [offset]. Like translate the ray is brought into the space of the
+// object, and the hit back to the world. The transform can be changed
+// between renders to animate the object
+class transform : public hittable
+{
+public:
+
+  transform(std::shared_ptr<hittable> object, const vec3& offset,
+            const vec3& rotation = vec3(0, 0, 0), const vec3& scale = vec3(1, 1, 1))
+    : object(object)
+  {
+    set(offset, rotation, scale);
+  }
+
+  bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+  {
+    // The direction is not normalized, so t is the same in both spaces
+    ray object_r(apply(to_object, r.origin() - offset), apply(to_object, r.direction()),
+                 r.spread());
+
+    if (!object->hit(object_r, ray_t, rec))
+      return false;
+
+    rec.p = apply(to_world, rec.p) + offset;
+    // Normals go through the inverse transpose
+    rec.normal = unit_vector(apply_transposed(to_object, rec.normal));
+    return true;
+  }
+
+  bool occluded(const ray& r, interval ray_t) const override
+  {
+    return object->occluded(ray(apply(to_object, r.origin() - offset),
+                                apply(to_object, r.direction()), r.spread()), ray_t);
+  }
+
+  aabb bounding_box() const override { return bbox; }
+
+  void set(const vec3& new_offset, const vec3& rotation, const vec3& scale)
+  {
+    offset = new_offset;
+
+    // Rows of rz * ry * rx
+    double cx = std::cos(degrees_to_radians(rotation.x())), sx = std::sin(degrees_to_radians(rotation.x()));
+    double cy = std::cos(degrees_to_radians(rotation.y())), sy = std::sin(degrees_to_radians(rotation.y()));
+    double cz = std::cos(degrees_to_radians(rotation.z())), sz = std::sin(degrees_to_radians(rotation.z()));
+    vec3 rows[3] = {
+      vec3(cz * cy, cz * sy * sx - sz * cx, cz * sy * cx + sz * sx),
+      vec3(sz * cy, sz * sy * sx + cz * cx, sz * sy * cx - cz * sx),
+      vec3(-sy,     cy * sx,                cy * cx),
+    };
+
+    // to_world = rotation * scale, to_object = scale^-1 * rotation^T
+    for (int i = 0; i < 3; ++i)
+    {
+      to_world[i]  = rows[i] * scale;
+      to_object[i] = vec3(rows[0][i], rows[1][i], rows[2][i]) / scale[i];
+    }
+
+    // Box of the transformed corners of the object box
+    aabb local = object->bounding_box();
+    bbox = aabb::empty;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+      point3 p((corner & 1) ? local.x.max : local.x.min,
+               (corner & 2) ? local.y.max : local.y.min,
+               (corner & 4) ? local.z.max : local.z.min);
+      p = apply(to_world, p) + offset;
+      bbox = aabb(bbox, aabb(p, p));
+    }
+  }
+
+private:
+
+  std::shared_ptr<hittable> object;
+  vec3 offset;
+  vec3 to_world[3];   // rows of the linear part
+  vec3 to_object[3];  // rows of its inverse
+  aabb bbox;
+
+  static vec3 apply(const vec3 (&m)[3], const vec3& v)
+  {
+    return vec3(dot(m[0], v), dot(m[1], v), dot(m[2], v));
+  }
+
+  static vec3 apply_transposed(const vec3 (&m)[3], const vec3& v)
+  {
+    return v.x() * m[0] + v.y() * m[1] + v.z() * m[2];
+  }
 };
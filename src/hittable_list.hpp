@@ -20,29 +20,52 @@ public:
   hittable_list(std::shared_ptr<hittable> object)
   { this->add(object); }
 
-  void clear() { this->objects.clear(); }
+  void clear()
+  {
+    this->objects.clear();
+    this->bbox = aabb();
+  }
 
   void add(std::shared_ptr<hittable> object)
-  { this->objects.push_back(object); }
+  {
+    this->objects.push_back(object);
+    this->bbox = aabb(this->bbox, object->bounding_box());
+  }
 
   // Returns true and fils [rec] with the latest hit information if
-  // any of the object were hit
+  // any of the object were hit. The primitive of [rec] is the index
+  // of the object in the list
   bool hit(const ray& r, interval ray_t, hit_record& rec) const override
   {
     hit_record temp_rec;
     bool hit_anything = false;
     auto closest_so_far = ray_t.max;
 
-    for (const auto& object : objects)
+    for (std::size_t i = 0; i < objects.size(); ++i)
     {
-      if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec))
+      if (objects[i]->hit(r, interval(ray_t.min, closest_so_far), temp_rec))
       {
         hit_anything = true;
         closest_so_far = temp_rec.t;
         rec = temp_rec;
+        rec.primitive = int(i);
       }
     }
 
     return hit_anything;
   }
+
+  bool occluded(const ray& r, interval ray_t) const override
+  {
+    for (const auto& object : objects)
+      if (object->occluded(r, ray_t))
+        return true;
+    return false;
+  }
+
+  aabb bounding_box() const override { return this->bbox; }
+
+private:
+
+  aabb bbox;
 };
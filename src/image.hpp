@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "color.hpp"
+
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// A framebuffer of linear colors
+class image
+{
+public:
+
+  image() {}
+  image(int width, int height)
+    : width(width), height(height), pixels(std::size_t(width) * height) {}
+
+  int width  = 0;
+  int height = 0;
+  std::vector<color> pixels;
+
+  color* row(int j)             { return pixels.data() + std::size_t(j) * width; }
+  const color* row(int j) const { return pixels.data() + std::size_t(j) * width; }
+
+  // Writes the image in plain PPM format to [out]
+  void write_ppm(std::ostream& out) const
+  {
+    out << "P3\n" << width << ' ' << height << "\n255\n";
+    for (const auto& pixel : pixels)
+      write_color(out, pixel);
+  }
+
+  // Writes the image in plain PPM format to the file at [path],
+  // returns false if the file could not be written
+  bool save_ppm(const std::string& path) const
+  {
+    std::ofstream out(path);
+    if (!out)
+    {
+      std::clog << "Could not open " << path << " for writing\n";
+      return false;
+    }
+    write_ppm(out);
+    return bool(out);
+  }
+
+  // Reads a plain (P3) or binary (P6) PPM file, the colors are
+  // converted from gamma to linear space. Returns false if the file
+  // could not be read
+  bool load_ppm(const std::string& path)
+  {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int w = 0, h = 0, maxval = 0;
+    if (!(in >> magic) || (magic != "P3" && magic != "P6")
+        || !read_ppm_int(in, w) || !read_ppm_int(in, h) || !read_ppm_int(in, maxval)
+        || w <= 0 || h <= 0 || maxval <= 0 || maxval > 255)
+    {
+      std::clog << "Could not read PPM image " << path << "\n";
+      return false;
+    }
+    in.get();  // the single whitespace before the raster
+
+    *this = image(w, h);
+    for (auto& pixel : pixels)
+    {
+      for (int k = 0; k < 3; ++k)
+      {
+        int value = 0;
+        if (magic == "P6")
+          value = in.get();
+        else
+          in >> value;
+        double gamma = double(value) / maxval;
+        pixel[k] = gamma * gamma;
+      }
+    }
+
+    if (!in)
+    {
+      std::clog << "Truncated PPM image " << path << "\n";
+      return false;
+    }
+    return true;
+  }
+
+private:
+
+  // Reads a header value, skipping '#' comments
+  static bool read_ppm_int(std::istream& in, int& value)
+  {
+    while (in >> std::ws && in.peek() == '#')
+      in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    return bool(in >> value);
+  }
+};
@@ -17,6 +17,11 @@ public:
 
   interval(double min, double max) : min(min), max(max) {}
 
+  // The tightest interval enclosing both [a] and [b]
+  interval(const interval& a, const interval& b)
+    : min(a.min <= b.min ? a.min : b.min),
+      max(a.max >= b.max ? a.max : b.max) {}
+
   double size() const
   {
     return this->max - this->min;
@@ -39,8 +44,19 @@ public:
     return x;
   }
 
+  interval expand(double delta) const
+  {
+    auto padding = delta / 2;
+    return interval(min - padding, max + padding);
+  }
+
   static const interval empty, universe;
 };
 
-const interval interval::empty = interval(+infinity, -infinity);
-const interval interval::universe = interval(-infinity, +infinity);
+inline const interval interval::empty = interval(+infinity, -infinity);
+inline const interval interval::universe = interval(-infinity, +infinity);
+
+inline interval operator+(const interval& ival, double displacement)
+{
+  return interval(ival.min + displacement, ival.max + displacement);
+}
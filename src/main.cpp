@@ -86,7 +86,7 @@ int main(void)
   // such as .ppng or .jpeg. We will convert the framebuffer to a PBM
   // because of its simplicity.
   //
-  cam.render(world);
+  cam.render(bvh(world));
   
   return 0;
 }
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "camera.hpp"
+#include "color.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum class image_format
+{
+  ppm,  // binary PPM (P6), 8 bit gamma encoded
+  pfm,  // PFM, 32 bit float linear
+};
+
+// An image file written in place through a memory mapping.
+//
+// The file is created at its final size with a complete header, so
+// it is a valid image at any time: the parts not written yet are
+// black. Pixels go straight to their final position in the file and
+// release_rows() hands finished rows back to the kernel, so the
+// memory used does not grow with the size of the image.
+//
+// The blocks of the file are allocated up front. When the disk is
+// too full for the image, ok() is false instead of a later write to
+// the mapping failing.
+class mapped_image
+{
+public:
+
+  mapped_image(const std::string& path, int width, int height, image_format format)
+    : width(width), height(height), format(format)
+  {
+    std::string header = (format == image_format::ppm)
+      ? "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n"
+      : "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n-1.0\n";
+    header_size = header.size();
+    pixel_size  = (format == image_format::ppm) ? 3 : 3 * sizeof(float);
+    file_size   = header_size + std::size_t(width) * height * pixel_size;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+      std::clog << "Could not create " << path << "\n";
+      return;
+    }
+
+    // A sparse file would only run out of space when the mapping is
+    // written, which raises SIGBUS
+    if (int error = ::posix_fallocate(fd, 0, off_t(file_size)); error != 0)
+    {
+      std::clog << "Could not allocate " << file_size << " bytes for " << path << ": "
+                << std::strerror(error) << "\n";
+      ::close(fd);
+      ::unlink(path.c_str());
+      return;
+    }
+
+    void* mapping = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file open
+    if (mapping == MAP_FAILED)
+    {
+      std::clog << "Could not map " << path << "\n";
+      return;
+    }
+
+    data = static_cast<unsigned char*>(mapping);
+    std::memcpy(data, header.data(), header_size);
+  }
+
+  ~mapped_image()
+  {
+    if (data)
+    {
+      ::msync(data, file_size, MS_SYNC);
+      ::munmap(data, file_size);
+    }
+  }
+
+  mapped_image(const mapped_image&) = delete;
+  mapped_image& operator=(const mapped_image&) = delete;
+
+  const int width;
+  const int height;
+  const image_format format;
+
+  bool ok() const { return data != nullptr; }
+
+  // Writes [count] linear colors at pixel ([i], [j]) onwards
+  void write_span(int i, int j, int count, const color* pixels)
+  {
+    // PFM stores the rows from the bottom up
+    int row = (format == image_format::pfm) ? height - 1 - j : j;
+    auto* out = data + header_size + (std::size_t(row) * width + i) * pixel_size;
+
+    if (format == image_format::ppm)
+    {
+      static const interval intensity(0.000, 0.999);
+      for (int k = 0; k < count; ++k)
+        for (int c = 0; c < 3; ++c)
+          *out++ = std::uint8_t(256 * intensity.clamp(linear_to_gamma(pixels[k][c])));
+    }
+    else
+    {
+      for (int k = 0; k < count; ++k)
+      {
+        float rgb[3] = { float(pixels[k][0]), float(pixels[k][1]), float(pixels[k][2]) };
+        std::memcpy(out, rgb, sizeof(rgb));
+        out += sizeof(rgb);
+      }
+    }
+  }
+
+  // Starts writing rows [j0, j1) back to the file and drops them from
+  // the memory of the process. Pages shared with other rows are kept
+  void release_rows(int j0, int j1)
+  {
+    if (format == image_format::pfm)
+    {
+      int flipped = height - j1;
+      j1 = height - j0;
+      j0 = flipped;
+    }
+
+    const std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE));
+    std::size_t begin = header_size + std::size_t(j0) * width * pixel_size;
+    std::size_t end   = header_size + std::size_t(j1) * width * pixel_size;
+    begin = (begin + page - 1) / page * page;
+    end   = end / page * page;
+    if (begin >= end)
+      return;
+
+    ::msync(data + begin, end - begin, MS_ASYNC);
+    ::madvise(data + begin, end - begin, MADV_DONTNEED);
+  }
+
+private:
+
+  unsigned char* data = nullptr;
+  std::size_t header_size = 0;
+  std::size_t pixel_size  = 0;
+  std::size_t file_size   = 0;
+};
+
+// Renders [world] through [cam] straight into the file at [path],
+// one [tile_size] square tile per task on [pool]. Every worker renders
+// into a buffer of one tile, and a band of tiles is released from
+// memory as soon as all of its tiles are done, so the memory used
+// depends on the tiles in flight and not on the image size.
+template <typename World>
+bool render_to_file(camera cam, const World& world, const std::string& path,
+                    image_format format, thread_pool& pool, int tile_size = 64)
+{
+  cam.initialize();
+  mapped_image output(path, cam.image_width, cam.height(), format);
+  if (!output.ok())
+    return false;
+
+  const int tiles_x = (cam.image_width + tile_size - 1) / tile_size;
+  const int tiles_y = (cam.height() + tile_size - 1) / tile_size;
+
+  std::unique_ptr<std::atomic<int>[]> band_remaining(new std::atomic<int>[tiles_y]);
+  for (int ty = 0; ty < tiles_y; ++ty)
+    band_remaining[ty] = tiles_x;
+  std::atomic<int> bands_remaining{tiles_y};
+
+  parallel_for(pool, tiles_x * tiles_y, [&](int tile)
+  {
+    int tx = tile % tiles_x, ty = tile / tiles_x;
+    int i0 = tx * tile_size, i1 = std::min(i0 + tile_size, cam.image_width);
+    int j0 = ty * tile_size, j1 = std::min(j0 + tile_size, cam.height());
+
+    std::vector<color> span(std::size_t(i1 - i0));
+    for (int j = j0; j < j1; ++j)
+    {
+      cam.render_span(world, j, i0, i1, span.data());
+      output.write_span(i0, j, i1 - i0, span.data());
+    }
+
+    if (--band_remaining[ty] == 0)
+    {
+      output.release_rows(j0, j1);
+      std::clog << "\rTile rows remaining: " << --bands_remaining << "\n" << std::flush;
+    }
+  });
+  return true;
+}
+
+template <typename World>
+bool render_to_file(const camera& cam, const World& world, const std::string& path,
+                    image_format format, int tile_size = 64)
+{
+  thread_pool pool;
+  return render_to_file(cam, world, path, format, pool, tile_size);
+}
@@ -3,7 +3,12 @@
 // Mail:    giovanni.santini@proton.me
 // Github:  @San7o
 
+#pragma once
+
 #include "hittable.hpp"
+#include "texture.hpp"
+
+#include <memory>
 
 class material
 {
@@ -20,13 +25,25 @@ public:
   {
     return false;
   }
+
+  // Density, over solid angle, with which scatter() picks the
+  // direction of [scattered]. Zero for the materials whose scattering
+  // is not a density over directions, such as mirrors, which path
+  // guiding leaves alone
+  virtual double scattering_pdf([[maybe_unused]] const ray& r_in,
+                                [[maybe_unused]] const hit_record& rec,
+                                [[maybe_unused]] const ray& scattered) const
+  {
+    return 0;
+  }
 };
 
 class lambertian : public material
 {
 public:
 
-  lambertian(const color& albedo) : albedo(albedo) {}
+  lambertian(const color& albedo) : tex(std::make_shared<solid_color>(albedo)) {}
+  lambertian(std::shared_ptr<texture> tex) : tex(tex) {}
 
   bool scatter([[maybe_unused]] const ray& r_int,
                const hit_record& rec,
@@ -49,15 +66,30 @@ public:
     if (scatter_direction.near_zero())
       scatter_direction = rec.normal;
  
-    scattered = ray(rec.p, scatter_direction);
-    attenuation = albedo;
+    scattered = ray(rec.p, scatter_direction, diffuse_spread);
+    attenuation = tex->value(rec);
     return true;
   }
 
+  // The attenuation of scatter() is the albedo, the cosine of the
+  // brdf is all in the density
+  double scattering_pdf([[maybe_unused]] const ray& r_in,
+                        const hit_record& rec,
+                        const ray& scattered) const override
+  {
+    auto cos_theta = dot(rec.normal, unit_vector(scattered.direction()));
+    return cos_theta < 0 ? 0 : cos_theta / pi;
+  }
+
 private:
 
-  color albedo;  // the base color of the object, this is the color
-                 // that will be reflected
+  // Diffuse bounces cover the whole hemisphere and whatever texture
+  // detail they pick up is averaged over many samples, so they are
+  // given a wide cone that reads the coarse MIP levels
+  static constexpr double diffuse_spread = 0.25;
+
+  std::shared_ptr<texture> tex;  // the base color of the object, this
+                                 // is the color that will be reflected
 };
 
 class metal : public material
@@ -65,22 +97,25 @@ class metal : public material
 public:
 
   metal(const color& albedo, double fuzz)
-    : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+    : metal(std::make_shared<solid_color>(albedo), fuzz) {}
+
+  metal(std::shared_ptr<texture> tex, double fuzz)
+    : tex(tex), fuzz(fuzz < 1 ? fuzz : 1) {}
 
   bool scatter(const ray& r_in, const hit_record &rec,
                color& attenuation, ray& scattered) const override
   {
     vec3 reflected = reflect(r_in.direction(), rec.normal);
     reflected = unit_vector(reflected) + (fuzz * random_unit_vector());
-    scattered = ray(rec.p, reflected);
-    attenuation = albedo;
+    scattered = ray(rec.p, reflected, r_in.spread() + fuzz);
+    attenuation = tex->value(rec);
     return (dot(scattered.direction(), rec.normal) > 0);
   }
 
 private:
   
-  color  albedo; // the base color of the object, this is the color
-                 // that will be reflected
+  std::shared_ptr<texture> tex;  // the base color of the object, this
+                                 // is the color that will be reflected
   double fuzz;   // fuzz scatters the reflection in a random direction
                  // to make the color more blurry
 };
@@ -105,9 +140,10 @@ public:
 
     vec3 unit_direction = unit_vector(r_in.direction());
     double cos_theta = std::fmin(dot(-unit_direction, rec.normal), 1.0);
-    double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+    double sin_theta_squared = 1.0 - cos_theta * cos_theta;
 
-    bool cannot_refract = ri * sin_theta > 1.0;
+    // ri * sin_theta > 1, compared squared to skip the square root
+    bool cannot_refract = ri * ri * sin_theta_squared > 1.0;
     vec3 direction;
 
     if (cannot_refract || reflectance(cos_theta, ri) > random_double())
@@ -115,7 +151,7 @@ public:
     else
       direction = refract(unit_direction, rec.normal, ri);
 
-    scattered = ray(rec.p, direction);
+    scattered = ray(rec.p, direction, r_in.spread());
     return true;
   }
 
@@ -131,6 +167,6 @@ private:
     // Use Schlick's approximation for reflectance
     auto r0 = (1 - refraction_index) / (1 + refraction_index);
     r0 = r0 * r0;
-    return r0 + (1 - r0) * std::pow((1-cosine), 5);
+    return r0 + (1 - r0) * ipow<5>(1 - cosine);
   }
 };
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "camera.hpp"
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One camera of a multi-view render and the file its image goes to
+struct render_view
+{
+  camera      cam;
+  std::string path;  // output PPM file
+};
+
+// Renders every view of [views] against the same [world]. The
+// scanlines of all views are queued on [pool] together, so workers
+// move on to the next view instead of waiting for the slowest
+// scanline of the current one. Each view is written to its file by
+// whichever worker finishes its last scanline.
+template <typename World>
+void render_views(const World& world, std::vector<render_view>& views, thread_pool& pool)
+{
+  struct view_state
+  {
+    image            framebuffer;
+    std::atomic<int> remaining;
+  };
+
+  std::vector<std::unique_ptr<view_state>> states;
+  for (auto& view : views)
+  {
+    view.cam.initialize();
+    auto state = std::make_unique<view_state>();
+    state->framebuffer = image(view.cam.image_width, view.cam.height());
+    state->remaining   = view.cam.height();
+    states.push_back(std::move(state));
+  }
+
+  // Interleave the views so that the queue does not drain one view
+  // at a time
+  int max_height = 0;
+  for (const auto& view : views)
+    max_height = std::max(max_height, view.cam.height());
+
+  std::vector<std::pair<std::size_t, int>> scanlines;  // view, row
+  for (int j = 0; j < max_height; ++j)
+    for (std::size_t k = 0; k < views.size(); ++k)
+      if (j < views[k].cam.height())
+        scanlines.push_back({ k, j });
+
+  parallel_for(pool, int(scanlines.size()), [&](int n)
+  {
+    auto [k, j] = scanlines[std::size_t(n)];
+    auto& state = *states[k];
+    views[k].cam.render_scanline(world, j, state.framebuffer.row(j));
+
+    if (--state.remaining == 0)
+    {
+      state.framebuffer.save_ppm(views[k].path);
+      state.framebuffer = image();  // release the memory early
+      std::clog << "Wrote " << views[k].path << "\n" << std::flush;
+    }
+  });
+}
+
+template <typename World>
+void render_views(const World& world, std::vector<render_view>& views)
+{
+  thread_pool pool;
+  render_views(world, views, pool);
+}
+
+//
+// Presets
+// -------
+//
+// The presets derive new cameras from the frame that
+// camera::initialize computes for [base].
+//
+
+// Left and right eye cameras, [eye_separation] apart along the
+// camera's right direction. Both eyes look parallel to the base
+// view direction
+inline std::array<camera, 2> stereo_pair(camera base, double eye_separation)
+{
+  base.initialize();
+  auto offset = 0.5 * eye_separation * base.right();
+
+  camera left  = base;
+  left.lookfrom  = base.lookfrom - offset;
+  left.lookat    = base.lookat   - offset;
+
+  camera right = base;
+  right.lookfrom = base.lookfrom + offset;
+  right.lookat   = base.lookat   + offset;
+
+  return { left, right };
+}
+
+constexpr std::array<const char*, 6> cube_map_face_names
+  = { "front", "back", "left", "right", "up", "down" };
+
+// The six square 90 degrees faces of a cube map centered at the
+// base camera position, in the order of cube_map_face_names. The
+// faces are oriented relative to the base camera frame and use
+// image_width as their side
+inline std::array<camera, 6> cube_map(camera base)
+{
+  base.initialize();
+  const vec3 forward = -base.backward();
+  const vec3 right   = base.right();
+  const vec3 up      = base.up();
+
+  const std::array<vec3, 6> directions
+    = { forward, -forward, -right, right, up, -up };
+  const std::array<vec3, 6> ups
+    = { up, up, up, up, -forward, forward };
+
+  std::array<camera, 6> faces;
+  for (std::size_t f = 0; f < faces.size(); ++f)
+  {
+    camera face = base;
+    face.aspect_ratio  = 1.0;
+    face.vfov          = 90;
+    face.defocus_angle = 0;
+    face.lookat        = base.lookfrom + directions[f];
+    face.vup           = ups[f];
+    faces[f] = face;
+  }
+  return faces;
+}
@@ -0,0 +1,614 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "hittable.hpp"
+#include "sphere.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//
+// Out-of-core scenes
+// ------------------
+//
+// A paged scene keeps its spheres and its bounding volume hierarchy
+// in a binary file that is memory mapped instead of loaded, so that
+// the scene can be larger than the memory of the machine. The kernel
+// reads the parts of the file the rays touch, the scene tracks which
+// chunks of the file it has touched and, when they exceed the resident
+// memory budget, gives back to the kernel the ones not used recently.
+//
+// The nodes and the spheres are written in depth-first order, so a
+// subtree and its spheres lie in few consecutive chunks.
+//
+// The file layout is:
+//
+//   header                 (see paged_scene_header)
+//   nodes                  (paged_node, at node_offset)
+//   spheres                (paged_sphere, at sphere_offset)
+//
+
+// A sphere as stored in the file. Single precision keeps the records
+// small, the file is read by the page
+struct paged_sphere
+{
+  float center[3];
+  float radius;
+  std::uint32_t material;  // index in the material table of the scene
+};
+
+// Leaves have count > 0 and hold spheres [first, first + count).
+// Inner nodes have their left child right after them and the right
+// child at index first
+struct paged_node
+{
+  float bounds[6];  // min x y z, max x y z
+  std::uint32_t first;
+  std::uint16_t count;
+  std::uint16_t axis;
+};
+
+struct paged_scene_header
+{
+  char          magic[4];  // "RTOC"
+  std::uint32_t version;
+  std::uint64_t node_count;
+  std::uint64_t sphere_count;
+  std::uint64_t node_offset;
+  std::uint64_t sphere_offset;
+};
+
+// Builds the hierarchy over [spheres] and writes the scene to [path]
+inline bool write_paged_scene(std::vector<paged_sphere> spheres, const std::string& path)
+{
+  constexpr int max_leaf_size = 4;
+  std::vector<paged_node> nodes;
+  nodes.reserve(spheres.size());
+
+  auto sphere_bounds = [](const paged_sphere& s, float* bounds)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      // Round outwards so that the boxes stay conservative
+      bounds[k]     = std::nextafter(s.center[k] - s.radius, -INFINITY);
+      bounds[k + 3] = std::nextafter(s.center[k] + s.radius, +INFINITY);
+    }
+  };
+
+  auto build = [&](auto& self, std::uint32_t start, std::uint32_t end) -> std::uint32_t
+  {
+    auto index = std::uint32_t(nodes.size());
+    nodes.emplace_back();
+
+    float bounds[6] = { INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY };
+    float centroid_bounds[6] = { INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY };
+    for (auto i = start; i < end; ++i)
+    {
+      float b[6];
+      sphere_bounds(spheres[i], b);
+      for (int k = 0; k < 3; ++k)
+      {
+        bounds[k]     = std::min(bounds[k], b[k]);
+        bounds[k + 3] = std::max(bounds[k + 3], b[k + 3]);
+        centroid_bounds[k]     = std::min(centroid_bounds[k], spheres[i].center[k]);
+        centroid_bounds[k + 3] = std::max(centroid_bounds[k + 3], spheres[i].center[k]);
+      }
+    }
+
+    paged_node node{};
+    std::copy(bounds, bounds + 6, node.bounds);
+
+    if (end - start <= max_leaf_size)
+    {
+      node.first = start;
+      node.count = std::uint16_t(end - start);
+      nodes[index] = node;
+      return index;
+    }
+
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+      if (centroid_bounds[k + 3] - centroid_bounds[k]
+          > centroid_bounds[axis + 3] - centroid_bounds[axis])
+        axis = k;
+
+    auto mid = start + (end - start) / 2;
+    std::nth_element(spheres.begin() + start, spheres.begin() + mid, spheres.begin() + end,
+                     [axis](const paged_sphere& a, const paged_sphere& b)
+                     { return a.center[axis] < b.center[axis]; });
+
+    self(self, start, mid);
+    node.first = self(self, mid, end);
+    node.axis  = std::uint16_t(axis);
+    nodes[index] = node;
+    return index;
+  };
+
+  if (!spheres.empty())
+    build(build, 0, std::uint32_t(spheres.size()));
+
+  // Sections start on page boundaries
+  auto align = [](std::uint64_t offset) { return (offset + 4095) & ~std::uint64_t(4095); };
+
+  paged_scene_header header{};
+  std::memcpy(header.magic, "RTOC", 4);
+  header.version       = 1;
+  header.node_count    = nodes.size();
+  header.sphere_count  = spheres.size();
+  header.node_offset   = align(sizeof(header));
+  header.sphere_offset = align(header.node_offset + nodes.size() * sizeof(paged_node));
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+  {
+    std::clog << "Could not open " << path << " for writing\n";
+    return false;
+  }
+
+  auto write_at = [&out](std::uint64_t offset, const void* data, std::size_t size)
+  {
+    out.seekp(std::streamoff(offset));
+    out.write(static_cast<const char*>(data), std::streamsize(size));
+  };
+  write_at(0, &header, sizeof(header));
+  write_at(header.node_offset, nodes.data(), nodes.size() * sizeof(paged_node));
+  write_at(header.sphere_offset, spheres.data(), spheres.size() * sizeof(paged_sphere));
+
+  return bool(out);
+}
+
+class paged_scene : public hittable
+{
+public:
+
+  static constexpr std::size_t chunk_size = std::size_t(1) << 20;
+  static constexpr int         max_depth  = 64;
+
+  // Maps the scene at [path]. The spheres refer to [materials] by
+  // index, out of range indices get the last material. At most
+  // [resident_budget] bytes of the file are kept resident, at least
+  // four chunks. The primitive of a hit is the index of the sphere in
+  // the file, in tree order. ok() is false if the file cannot be
+  // mapped, its header does not match its size or its hierarchy is
+  // not a tree of at most max_depth levels over its spheres
+  paged_scene(const std::string& path, std::vector<std::shared_ptr<material>> materials,
+              std::size_t resident_budget = std::size_t(1) << 30)
+    : materials(std::move(materials)),
+      max_resident(std::max<std::size_t>(4, resident_budget / chunk_size))
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(paged_scene_header))
+    {
+      std::clog << "Could not open paged scene " << path << "\n";
+      if (fd >= 0)
+        ::close(fd);
+      return;
+    }
+
+    file_size = std::size_t(st.st_size);
+    void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file open
+    if (mapping == MAP_FAILED)
+    {
+      std::clog << "Could not map paged scene " << path << "\n";
+      return;
+    }
+
+    // Paging is driven by the traversal, readahead would only fill
+    // the budget with data the rays may never touch
+    ::madvise(mapping, file_size, MADV_RANDOM);
+
+    base = static_cast<const unsigned char*>(mapping);
+    const auto& header = *reinterpret_cast<const paged_scene_header*>(base);
+    if (std::memcmp(header.magic, "RTOC", 4) != 0 || header.version != 1)
+    {
+      std::clog << "Not a paged scene " << path << "\n";
+      ::munmap(const_cast<unsigned char*>(base), file_size);
+      base = nullptr;
+      return;
+    }
+
+    if (!section_fits(header.node_offset, header.node_count, sizeof(paged_node),
+                      alignof(paged_node))
+        || !section_fits(header.sphere_offset, header.sphere_count, sizeof(paged_sphere),
+                         alignof(paged_sphere))
+        || header.node_count > std::numeric_limits<std::uint32_t>::max()
+        || (header.sphere_count > 0 && this->materials.empty()))
+    {
+      std::clog << "Corrupt paged scene " << path << "\n";
+      ::munmap(const_cast<unsigned char*>(base), file_size);
+      base = nullptr;
+      return;
+    }
+
+    nodes        = reinterpret_cast<const paged_node*>(base + header.node_offset);
+    spheres      = reinterpret_cast<const paged_sphere*>(base + header.sphere_offset);
+    node_count   = header.node_count;
+
+    if (!valid_tree(header.sphere_count))
+    {
+      std::clog << "Corrupt hierarchy in paged scene " << path << "\n";
+      ::munmap(const_cast<unsigned char*>(base), file_size);
+      base = nullptr;
+      return;
+    }
+
+    // The check read all the nodes, leave them to the traversal to page in
+    const std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE));
+    std::size_t nodes_begin = header.node_offset / page * page;
+    ::madvise(const_cast<unsigned char*>(base) + nodes_begin,
+              header.node_offset + node_count * sizeof(paged_node) - nodes_begin,
+              MADV_DONTNEED);
+
+    chunks = std::vector<chunk_state>((file_size + chunk_size - 1) / chunk_size);
+  }
+
+  ~paged_scene()
+  {
+    if (base)
+      ::munmap(const_cast<unsigned char*>(base), file_size);
+  }
+
+  paged_scene(const paged_scene&) = delete;
+  paged_scene& operator=(const paged_scene&) = delete;
+
+  bool ok() const { return base != nullptr; }
+
+  bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+  {
+    if (!ok() || node_count == 0)
+      return false;
+
+    bool hit_anything = false;
+    std::uint32_t stack[max_depth + 1];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+      auto index = stack[--stack_size];
+      touch(&nodes[index]);
+
+      const paged_node& n = nodes[index];
+      if (!node_box(n).hit(r, ray_t))
+        continue;
+
+      if (n.count == 0)
+      {
+        push_children(index, r, stack, stack_size);
+        continue;
+      }
+
+      touch(&spheres[n.first]);
+      touch(&spheres[n.first + n.count - 1]);
+      hit_spheres(n.first, n.count, r, ray_t, rec, hit_anything);
+      if (hit_anything)
+        ray_t.max = rec.t;
+    }
+    return hit_anything;
+  }
+
+  // Intersects all of [rays] and returns for each of them whether it
+  // hit something, [recs] gets the closest hits.
+  //
+  // Rays reaching data that is not resident are deferred instead of
+  // waiting on a page fault. The deferred rays are grouped by the
+  // chunk they wait for, the chunks with the most waiting rays are
+  // read together and their rays resumed. Since only the closest hit
+  // is kept, the order in which subtrees are visited does not matter.
+  std::vector<bool> hit_batch(const std::vector<ray>& rays, interval ray_t,
+                              std::vector<hit_record>& recs) const
+  {
+    std::vector<bool> hits(rays.size(), false);
+    recs.resize(rays.size());
+    if (!ok() || node_count == 0)
+      return hits;
+
+    std::vector<double> closest(rays.size(), ray_t.max);
+    std::map<std::size_t, std::vector<deferred_ray>> waiting;  // by chunk
+    std::vector<deferred_ray> ready;
+    for (std::uint32_t i = 0; i < rays.size(); ++i)
+      ready.push_back({ i, 0, 0, 0 });
+
+    while (!ready.empty() || !waiting.empty())
+    {
+      for (const auto& d : ready)
+      {
+        const ray& r = rays[d.ray];
+        bool hit_anything = false;
+
+        // Resume a leaf whose spheres were not resident
+        if (d.count > 0)
+        {
+          if (auto chunk = missing_chunk(&spheres[d.first], d.count); chunk != no_chunk)
+            waiting[chunk].push_back(d);
+          else
+            hit_spheres(d.first, d.count, r, interval(ray_t.min, closest[d.ray]),
+                        recs[d.ray], hit_anything);
+        }
+        else
+        {
+          std::uint32_t stack[max_depth + 1];
+          int stack_size = 0;
+          stack[stack_size++] = d.node;
+
+          while (stack_size > 0)
+          {
+            auto index = stack[--stack_size];
+            if (auto chunk = missing_chunk(&nodes[index], 1); chunk != no_chunk)
+            {
+              waiting[chunk].push_back({ d.ray, index, 0, 0 });
+              continue;
+            }
+
+            const paged_node& n = nodes[index];
+            interval t(ray_t.min, hit_anything ? recs[d.ray].t : closest[d.ray]);
+            if (!node_box(n).hit(r, t))
+              continue;
+
+            if (n.count == 0)
+            {
+              push_children(index, r, stack, stack_size);
+              continue;
+            }
+
+            if (auto chunk = missing_chunk(&spheres[n.first], n.count); chunk != no_chunk)
+              waiting[chunk].push_back({ d.ray, index, n.first, n.count });
+            else
+              hit_spheres(n.first, n.count, r, t, recs[d.ray], hit_anything);
+          }
+        }
+
+        if (hit_anything)
+        {
+          hits[d.ray] = true;
+          closest[d.ray] = recs[d.ray].t;
+        }
+      }
+      ready.clear();
+
+      // Page in the chunks with the longest queues, leaving room in
+      // the budget for the chunks already resident
+      std::vector<std::pair<std::size_t, std::size_t>> queues;  // size, chunk
+      for (const auto& [chunk, queue] : waiting)
+        queues.push_back({ queue.size(), chunk });
+      std::sort(queues.rbegin(), queues.rend());
+
+      auto batch = std::min(queues.size(), std::max<std::size_t>(1, max_resident / 2));
+      for (std::size_t q = 0; q < batch; ++q)
+        page_in(queues[q].second, true);
+      for (std::size_t q = 0; q < batch; ++q)
+      {
+        auto& queue = waiting[queues[q].second];
+        ready.insert(ready.end(), queue.begin(), queue.end());
+        waiting.erase(queues[q].second);
+      }
+    }
+
+    return hits;
+  }
+
+  aabb bounding_box() const override
+  {
+    if (!ok() || node_count == 0)
+      return aabb::empty;
+    const auto* b = nodes[0].bounds;
+    return aabb(point3(b[0], b[1], b[2]), point3(b[3], b[4], b[5]));
+  }
+
+  std::size_t resident_bytes() const
+  {
+    std::lock_guard<std::mutex> lock(residency_mutex);
+    return clock_slots.size() * chunk_size;
+  }
+  std::uint64_t page_ins() const { return page_in_count; }
+
+private:
+
+  struct chunk_state
+  {
+    std::atomic<bool> resident{false};
+    std::atomic<bool> referenced{false};  // used since the clock hand last passed
+  };
+
+  // A ray waiting to resume the traversal at [node], or if [count]
+  // is not zero to test the spheres of a leaf
+  struct deferred_ray
+  {
+    std::uint32_t ray;
+    std::uint32_t node;
+    std::uint32_t first;
+    std::uint32_t count;
+  };
+
+  std::vector<std::shared_ptr<material>> materials;
+  const unsigned char* base = nullptr;
+  std::size_t          file_size = 0;
+  const paged_node*    nodes = nullptr;
+  const paged_sphere*  spheres = nullptr;
+  std::uint64_t        node_count = 0;
+
+  std::size_t max_resident;                 // in chunks
+  mutable std::vector<chunk_state> chunks;
+  mutable std::mutex residency_mutex;       // guards the clock and eviction
+  mutable std::vector<std::size_t> clock_slots;  // the resident chunks
+  mutable std::size_t clock_hand = 0;
+  mutable std::atomic<std::uint64_t> page_in_count{0};
+
+  // True if every node reachable from the root refers to nodes after
+  // it and to spheres in the file, and no leaf is deeper than
+  // max_depth, which bounds the traversal stacks. The visits are capped
+  // at node_count, so a crafted file that shares subtrees cannot make
+  // the check exponential
+  bool valid_tree(std::uint64_t sphere_count) const
+  {
+    if (node_count == 0)
+      return true;
+
+    std::vector<std::pair<std::uint32_t, int>> stack = { { 0, 0 } };  // node, depth
+    std::uint64_t visited = 0;
+    while (!stack.empty())
+    {
+      auto [index, depth] = stack.back();
+      stack.pop_back();
+      if (++visited > node_count || depth > max_depth)
+        return false;
+
+      const paged_node& n = nodes[index];
+      if (n.count > 0)
+      {
+        if (std::uint64_t(n.first) + n.count > sphere_count)
+          return false;
+        continue;
+      }
+
+      if (n.axis >= 3 || std::uint64_t(index) + 1 >= node_count || n.first <= index
+          || n.first >= node_count)
+        return false;
+      stack.push_back({ index + 1, depth + 1 });
+      stack.push_back({ n.first, depth + 1 });
+    }
+    return true;
+  }
+
+  // True if [count] records of [size] bytes at [offset] lie inside
+  // the file, suitably aligned
+  bool section_fits(std::uint64_t offset, std::uint64_t count, std::size_t size,
+                    std::size_t alignment) const
+  {
+    return offset % alignment == 0 && offset <= file_size
+      && count <= (file_size - offset) / size;
+  }
+
+  std::size_t chunk_of(const void* p) const
+  {
+    return std::size_t(static_cast<const unsigned char*>(p) - base) / chunk_size;
+  }
+
+  // Records the use of the chunk holding [p], reading it if needed
+  void touch(const void* p) const
+  {
+    auto chunk = chunk_of(p);
+    if (!chunks[chunk].resident.load(std::memory_order_relaxed))
+      page_in(chunk, false);
+    mark_used(chunk);
+  }
+
+  // Marks [chunk] resident. Over the budget a clock hand sweeps the
+  // resident chunks, clearing their referenced flag, and evicts the
+  // first one not used since its last pass. Eviction only drops clean
+  // pages of a read-only mapping, a thread still reading an evicted
+  // chunk faults it back in
+  void page_in(std::size_t chunk, bool prefetch) const
+  {
+    std::lock_guard<std::mutex> lock(residency_mutex);
+    if (chunks[chunk].resident.load(std::memory_order_relaxed))
+      return;
+
+    if (clock_slots.size() < max_resident)
+      clock_slots.push_back(chunk);
+    else
+    {
+      while (chunks[clock_slots[clock_hand]].referenced.exchange(false,
+                                                                 std::memory_order_relaxed))
+        clock_hand = (clock_hand + 1) % clock_slots.size();
+
+      auto victim = clock_slots[clock_hand];
+      ::madvise(const_cast<unsigned char*>(base) + victim * chunk_size,
+                chunk_length(victim), MADV_DONTNEED);
+      chunks[victim].resident.store(false, std::memory_order_relaxed);
+
+      clock_slots[clock_hand] = chunk;
+      clock_hand = (clock_hand + 1) % clock_slots.size();
+    }
+
+    if (prefetch)
+      ::madvise(const_cast<unsigned char*>(base) + chunk * chunk_size,
+                chunk_length(chunk), MADV_WILLNEED);
+    chunks[chunk].referenced.store(true, std::memory_order_relaxed);
+    chunks[chunk].resident.store(true, std::memory_order_relaxed);
+    ++page_in_count;
+  }
+
+  std::size_t chunk_length(std::size_t chunk) const
+  {
+    return std::min(chunk_size, file_size - chunk * chunk_size);
+  }
+
+  static constexpr std::size_t no_chunk = std::size_t(-1);
+
+  // Returns a chunk holding part of the [count] records at [first]
+  // that is not resident, or no_chunk. Resident chunks are marked used
+  template <typename Record>
+  std::size_t missing_chunk(const Record* first, std::size_t count) const
+  {
+    for (auto chunk : { chunk_of(first), chunk_of(first + count - 1) })
+    {
+      if (!chunks[chunk].resident.load(std::memory_order_relaxed))
+        return chunk;
+      mark_used(chunk);
+    }
+    return no_chunk;
+  }
+
+  void mark_used(std::size_t chunk) const
+  {
+    // Avoid writing the shared flag on every visit
+    if (!chunks[chunk].referenced.load(std::memory_order_relaxed))
+      chunks[chunk].referenced.store(true, std::memory_order_relaxed);
+  }
+
+  static aabb node_box(const paged_node& n)
+  {
+    return aabb(point3(n.bounds[0], n.bounds[1], n.bounds[2]),
+                point3(n.bounds[3], n.bounds[4], n.bounds[5]));
+  }
+
+  // Visit first the child on the side the ray comes from
+  void push_children(std::uint32_t index, const ray& r,
+                     std::uint32_t* stack, int& stack_size) const
+  {
+    std::uint32_t left = index + 1, right = nodes[index].first;
+    if (r.direction()[nodes[index].axis] < 0)
+      std::swap(left, right);
+    stack[stack_size++] = right;
+    stack[stack_size++] = left;
+  }
+
+  void hit_spheres(std::uint32_t first, std::uint32_t count, const ray& r,
+                   interval ray_t, hit_record& rec, bool& hit_anything) const
+  {
+    for (const auto* s = &spheres[first]; s < &spheres[first] + count; ++s)
+    {
+      if (sphere::intersect(point3(s->center[0], s->center[1], s->center[2]),
+                            s->radius, r, ray_t, rec))
+      {
+        hit_anything = true;
+        ray_t.max = rec.t;
+        rec.mat = materials[std::min<std::size_t>(s->material, materials.size() - 1)];
+        rec.primitive = int(s - spheres);
+      }
+    }
+  }
+};
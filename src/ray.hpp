@@ -12,12 +12,17 @@ class ray
 public:
   
   ray() {}
-  ray(const point3& origin, const vec3& direction)
-    : orig(origin), dir(direction) {}
+  ray(const point3& origin, const vec3& direction, double spread = 0)
+    : orig(origin), dir(direction), spr(spread) {}
 
   const point3& origin() const  { return this->orig; }
   const vec3& direction() const { return this->dir; }
 
+  // Angle of the cone of directions the ray stands for. A hit at
+  // distance d covers a patch about d * spread wide, textures use it
+  // to pick the resolution to sample
+  double spread() const { return this->spr; }
+
   point3 at(double t) const
   {
     return orig + t * dir;
@@ -27,5 +32,6 @@ private:
 
   point3 orig;
   vec3 dir;
-  
+  double spr = 0;
+
 };
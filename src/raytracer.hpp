@@ -10,8 +10,20 @@
 #include "ray.hpp"
 #include "color.hpp"
 #include "interval.hpp"
+#include "aabb.hpp"
 #include "hittable.hpp"
 #include "hittable_list.hpp"
+#include "bvh.hpp"
+#include "static_scene.hpp"
 #include "sphere.hpp"
+#include "tile_cache.hpp"
+#include "texture.hpp"
+#include "material.hpp"
+#include "guiding.hpp"
 #include "camera.hpp"
+#include "multiview.hpp"
+#include "sequence.hpp"
 #include "interval.hpp"
+
+// paged_scene.hpp and mapped_image.hpp map files with the POSIX API
+// and are included on their own where it is available
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "bvh.hpp"
+#include "camera.hpp"
+#include "hittable.hpp"
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Camera placement at a given frame. A zero [vup] or [focus_dist]
+// keeps the value of the camera of the sequence
+struct camera_keyframe
+{
+  double frame;
+  point3 lookfrom;
+  point3 lookat;
+  double vfov;
+  vec3   vup        = vec3(0, 0, 0);
+  double focus_dist = 0;
+};
+
+// Placement of an animated object at a given frame, see transform
+struct object_keyframe
+{
+  double frame;
+  vec3   offset;
+  vec3   rotation = vec3(0, 0, 0);  // degrees about x, y and z
+  vec3   scale    = vec3(1, 1, 1);
+};
+
+struct object_track
+{
+  std::shared_ptr<transform>   object;
+  std::vector<object_keyframe> keys;  // sorted by frame
+};
+
+// Returns the index of the key starting the segment that contains
+// [frame] and the interpolation factor inside that segment. Frames
+// before the first or after the last key hold that key
+template <typename Keyframe>
+std::size_t find_segment(const std::vector<Keyframe>& keys, double frame, double& t)
+{
+  t = 0;
+  if (keys.size() < 2 || frame <= keys.front().frame)
+    return 0;
+
+  for (std::size_t k = 0; k + 1 < keys.size(); ++k)
+  {
+    if (frame < keys[k + 1].frame)
+    {
+      t = (frame - keys[k].frame) / (keys[k + 1].frame - keys[k].frame);
+      return k;
+    }
+  }
+  return keys.size() - 1;
+}
+
+// An animation rendered as a numbered sequence of PPM files.
+//
+// Between frames the transforms of the tracked objects are updated
+// and the bounding volume hierarchy is refitted, not rebuilt. Each
+// frame is written by a background thread while the next one renders,
+// so the total time stays close to the sum of the render times.
+class sequence
+{
+public:
+
+  camera cam;  // image, sampling and lens settings shared by all frames
+  int    frame_count = 1;
+  std::string path_prefix = "frame_";  // frame 42 is written to <prefix>0042.ppm
+
+  std::vector<camera_keyframe> camera_keys;  // sorted by frame, may be empty
+  std::vector<object_track>    object_tracks;
+
+  // Renders all the frames of the animation of the objects of [world]
+  void render(bvh& world)
+  {
+    thread_pool pool;
+    render(world, pool);
+  }
+
+  void render(bvh& world, thread_pool& pool)
+  {
+    using clock = std::chrono::steady_clock;
+
+    auto   sequence_start = clock::now();
+    double render_seconds = 0;
+
+    image buffers[2];
+    std::future<bool> writer;
+
+    for (int n = 0; n < frame_count; ++n)
+    {
+      update_objects(n);
+      world.refit();
+
+      camera frame_cam = camera_at(n);
+      frame_cam.seed   = cam.seed + std::uint32_t(n);
+      frame_cam.initialize();
+
+      // The other buffer may still be being written
+      image& framebuffer = buffers[n % 2];
+      if (framebuffer.width != frame_cam.image_width
+          || framebuffer.height != frame_cam.height())
+        framebuffer = image(frame_cam.image_width, frame_cam.height());
+
+      auto render_start = clock::now();
+      parallel_for(pool, frame_cam.height(), [&](int j)
+      {
+        frame_cam.render_scanline(world, j, framebuffer.row(j));
+      });
+      std::chrono::duration<double> elapsed = clock::now() - render_start;
+      render_seconds += elapsed.count();
+
+      std::clog << "Frame " << n + 1 << "/" << frame_count << " rendered in "
+                << elapsed.count() << "s\n" << std::flush;
+
+      if (writer.valid())
+        writer.get();
+      writer = std::async(std::launch::async,
+                          [&framebuffer, path = frame_path(n)]
+                          { return framebuffer.save_ppm(path); });
+    }
+
+    if (writer.valid())
+      writer.get();
+
+    std::chrono::duration<double> total = clock::now() - sequence_start;
+    std::clog << "Sequence done in " << total.count() << "s, "
+              << render_seconds << "s spent rendering\n";
+  }
+
+  // Camera of frame [n], interpolated from the keyframes
+  camera camera_at(double n) const
+  {
+    camera result = cam;
+    if (camera_keys.empty())
+      return result;
+
+    double t;
+    auto k = find_segment(camera_keys, n, t);
+    const auto& a = camera_keys[k];
+    const auto& b = camera_keys[k + 1 < camera_keys.size() ? k + 1 : k];
+
+    result.lookfrom = (1 - t) * a.lookfrom + t * b.lookfrom;
+    result.lookat   = (1 - t) * a.lookat   + t * b.lookat;
+    result.vfov     = (1 - t) * a.vfov     + t * b.vfov;
+    if (a.vup.length_squared() > 0 && b.vup.length_squared() > 0)
+      result.vup = (1 - t) * a.vup + t * b.vup;
+    if (a.focus_dist > 0 && b.focus_dist > 0)
+      result.focus_dist = (1 - t) * a.focus_dist + t * b.focus_dist;
+    return result;
+  }
+
+  std::string frame_path(int n) const
+  {
+    std::ostringstream path;
+    path << path_prefix << std::setw(4) << std::setfill('0') << n << ".ppm";
+    return path.str();
+  }
+
+private:
+
+  void update_objects(double n)
+  {
+    for (auto& track : object_tracks)
+    {
+      if (track.keys.empty())
+        continue;
+
+      double t;
+      auto k = find_segment(track.keys, n, t);
+      const auto& a = track.keys[k];
+      const auto& b = track.keys[k + 1 < track.keys.size() ? k + 1 : k];
+      track.object->set((1 - t) * a.offset   + t * b.offset,
+                        (1 - t) * a.rotation + t * b.rotation,
+                        (1 - t) * a.scale    + t * b.scale);
+    }
+  }
+};
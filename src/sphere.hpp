@@ -11,9 +11,35 @@
 class sphere : public hittable {
 public:
   sphere(const point3& center, double radius, std::shared_ptr<material> mat)
-    :center(center), radius(std::fmax(0, radius)), mat(mat) {}
+    :center(center), radius(std::fmax(0, radius)), mat(mat)
+  {
+    auto rvec = vec3(this->radius, this->radius, this->radius);
+    bbox = aabb(center - rvec, center + rvec);
+  }
 
   bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+  {
+    if (!intersect(center, radius, r, ray_t, rec))
+      return false;
+
+    rec.mat = mat;
+    return true;
+  }
+
+  aabb bounding_box() const override { return bbox; }
+
+  // Skips the normal and the surface coordinates
+  bool occluded(const ray& r, interval ray_t) const override
+  {
+    double t;
+    return nearest_root(center, radius, r, ray_t, t);
+  }
+
+  // Intersects [r] with the sphere of [center] and [radius] and fills
+  // all of [rec] but the material. Shared with the containers that
+  // store spheres without sphere objects
+  static bool intersect(const point3& center, double radius, const ray& r,
+                        interval ray_t, hit_record& rec)
   {
     // Calculating if a ray hit the sphere is fairly simple. It is
     // the problem of calculating the intersection between a line
@@ -23,7 +49,28 @@ public:
     // solving for `d` distance from the origin of the line.
     // This implementation does some semplifications to speedup
     // calculation.
-    
+    double root;
+    if (!nearest_root(center, radius, r, ray_t, root))
+      return false;
+
+    rec.t = root;
+    rec.p = r.at(rec.t);
+    vec3 outward_normal = (rec.p - center) / radius;
+    rec.set_face_normal(r, outward_normal);
+    get_sphere_uv(outward_normal, rec.u, rec.v);
+    // A full turn in u is the equator, 2*pi*radius long
+    rec.footprint = rec.t * r.spread() * r.direction().length() / (2 * pi * radius);
+
+    return true;
+  }
+
+private:
+
+  // Finds in [t] the nearest distance along [r] in [ray_t] at which
+  // it crosses the sphere
+  static bool nearest_root(const point3& center, double radius, const ray& r,
+                           interval ray_t, double& t)
+  {
     vec3 oc = center - r.origin();
     auto a = r.direction().length_squared();
     auto h = dot(r.direction(), oc);
@@ -36,25 +83,30 @@ public:
     auto sqrtd = std::sqrt(discriminant);
 
     // Find the nearest root that lies in the acceptable range.
-    auto root = (h - sqrtd) / a;
-    if (!ray_t.surrounds(root))
+    t = (h - sqrtd) / a;
+    if (!ray_t.surrounds(t))
     {
-      root = (h + sqrtd) / a;
-      if (!ray_t.surrounds(root))
+      t = (h + sqrtd) / a;
+      if (!ray_t.surrounds(t))
         return false;
     }
-
-    rec.t = root;
-    rec.p = r.at(rec.t);
-    vec3 outward_normal = (rec.p - center) / radius;
-    rec.set_face_normal(r, outward_normal);
-    rec.mat = mat;
-    
     return true;
   }
 
-private:
+  // [p] is a point on the unit sphere centered at the origin.
+  // [u] is the angle around the Y axis from X=-1, normalized to [0,1].
+  // [v] is the angle from Y=-1 to Y=+1, normalized to [0,1].
+  static void get_sphere_uv(const point3& p, double& u, double& v)
+  {
+    auto theta = std::acos(-p.y());
+    auto phi   = std::atan2(-p.z(), p.x()) + pi;
+
+    u = phi / (2 * pi);
+    v = theta / pi;
+  }
+
   point3 center;
   double radius;
   std::shared_ptr<material> mat;
+  aabb bbox;
 };
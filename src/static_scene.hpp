@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A closed world scene whose primitive types are known at compile
+// time. Each type is stored by value in its own contiguous vector and
+// intersected with a non-virtual call, so the compiler can inline the
+// intersection code into the loop. Pass it to camera::render like a
+// hittable; use hittable_list and bvh for scenes built at run time.
+// Like in hittable_list, the primitive of a hit is the index of the
+// object in the order of the add() calls.
+//
+//   static_scene<sphere> world;
+//   world.add(sphere(point3(0, 0, -1), 0.5, material));
+//   cam.render(world);
+//
+template <typename... Primitives>
+class static_scene
+{
+public:
+
+  template <typename Primitive>
+  void add(Primitive primitive)
+  {
+    bbox = aabb(bbox, primitive.bounding_box());
+    std::get<std::vector<Primitive>>(primitives).push_back(std::move(primitive));
+    ids[index_of<Primitive>()].push_back(count++);
+  }
+
+  template <typename Primitive>
+  const std::vector<Primitive>& get() const
+  {
+    return std::get<std::vector<Primitive>>(primitives);
+  }
+
+  void clear()
+  {
+    (std::get<std::vector<Primitives>>(primitives).clear(), ...);
+    for (auto& type_ids : ids)
+      type_ids.clear();
+    count = 0;
+    bbox = aabb();
+  }
+
+  // Returns true and fills [rec] with the closest hit
+  bool hit(const ray& r, interval ray_t, hit_record& rec) const
+  {
+    bool hit_anything = false;
+    (hit_all(std::get<std::vector<Primitives>>(primitives), ids[index_of<Primitives>()],
+             r, ray_t, rec, hit_anything), ...);
+    return hit_anything;
+  }
+
+  aabb bounding_box() const { return bbox; }
+
+private:
+
+  std::tuple<std::vector<Primitives>...> primitives;
+  std::array<std::vector<int>, sizeof...(Primitives)> ids;  // add() order, per type
+  int  count = 0;
+  aabb bbox;
+
+  // Position of [Primitive] in the list of types
+  template <typename Primitive>
+  static constexpr std::size_t index_of()
+  {
+    std::size_t index = 0;
+    bool found = false;
+    ((found = found || std::is_same_v<Primitive, Primitives>, index += !found), ...);
+    return index;
+  }
+
+  template <typename Primitive>
+  static void hit_all(const std::vector<Primitive>& objects, const std::vector<int>& object_ids,
+                      const ray& r, interval& ray_t, hit_record& rec, bool& hit_anything)
+  {
+    // Work on a local copy, the compiler cannot tell that writes to
+    // [rec] do not change [ray_t]
+    interval t = ray_t;
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+      // The qualified call bypasses the virtual dispatch
+      if (objects[i].Primitive::hit(r, t, rec))
+      {
+        hit_anything = true;
+        t.max = rec.t;
+        rec.primitive = object_ids[i];
+      }
+    }
+    ray_t = t;
+  }
+};
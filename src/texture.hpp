@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "color.hpp"
+#include "hittable.hpp"
+#include "tile_cache.hpp"
+
+#include <cmath>
+#include <memory>
+#include <string>
+
+// A texture gives the color of a surface at a hit point
+class texture
+{
+public:
+  virtual ~texture() = default;
+
+  virtual color value(const hit_record& rec) const = 0;
+};
+
+class solid_color : public texture
+{
+public:
+
+  solid_color(const color& albedo) : albedo(albedo) {}
+
+  solid_color(double red, double green, double blue)
+    : solid_color(color(red, green, blue)) {}
+
+  color value([[maybe_unused]] const hit_record& rec) const override
+  {
+    return albedo;
+  }
+
+private:
+
+  color albedo;
+};
+
+// A procedural 3D checkerboard of cubes [scale] wide
+class checker_texture : public texture
+{
+public:
+
+  checker_texture(double scale, std::shared_ptr<texture> even,
+                  std::shared_ptr<texture> odd)
+    : inv_scale(1.0 / scale), even(even), odd(odd) {}
+
+  checker_texture(double scale, const color& c1, const color& c2)
+    : checker_texture(scale, std::make_shared<solid_color>(c1),
+                      std::make_shared<solid_color>(c2)) {}
+
+  color value(const hit_record& rec) const override
+  {
+    auto x = int(std::floor(inv_scale * rec.p.x()));
+    auto y = int(std::floor(inv_scale * rec.p.y()));
+    auto z = int(std::floor(inv_scale * rec.p.z()));
+
+    return ((x + y + z) % 2 == 0) ? even->value(rec) : odd->value(rec);
+  }
+
+private:
+
+  double inv_scale;
+  std::shared_ptr<texture> even;
+  std::shared_ptr<texture> odd;
+};
+
+// A texture read from a tiled texture file (see make_tiled_texture).
+// Tiles are loaded on first use through a tile_cache, so only the
+// parts of the image at the resolution seen by the rays take memory.
+// The MIP level is picked so that a texel matches the footprint of
+// the ray at the hit point, then sampled bilinearly. The image
+// repeats horizontally and is clamped vertically.
+class image_texture : public texture
+{
+public:
+
+  image_texture(const std::string& path,
+                std::shared_ptr<tile_cache> cache = default_tile_cache())
+    : file(std::make_shared<tiled_texture_file>(path)), cache(cache)
+  {
+    if (file->ok() && !cache->holds(file->tile_bytes()))
+    {
+      std::clog << "Tile cache of " << (cache->capacity() >> 10) << " KiB is too small for "
+                << "the tiles of " << path << "\n";
+      file->levels.clear();
+    }
+  }
+
+  color value(const hit_record& rec) const override
+  {
+    // Missing data shows up in cyan
+    if (!file->ok())
+      return color(0, 1, 1);
+
+    const auto& levels = file->levels;
+    int level = 0;
+    auto texels_per_footprint = rec.footprint * levels[0].width;
+    if (texels_per_footprint > 1)
+      level = std::min(int(std::log2(texels_per_footprint)), int(levels.size()) - 1);
+    const auto& l = levels[level];
+
+    auto x = (rec.u - std::floor(rec.u)) * l.width - 0.5;
+    auto y = (1.0 - interval(0, 1).clamp(rec.v)) * l.height - 0.5;
+    auto x0 = std::floor(x), y0 = std::floor(y);
+    auto fx = x - x0, fy = y - y0;
+
+    tile_lookup lookup;
+    int i0 = int(x0), j0 = int(y0);
+    return (1 - fy) * ((1 - fx) * texel(lookup, level, i0,     j0)
+                       +     fx  * texel(lookup, level, i0 + 1, j0))
+         +      fy  * ((1 - fx) * texel(lookup, level, i0,     j0 + 1)
+                       +     fx  * texel(lookup, level, i0 + 1, j0 + 1));
+  }
+
+  const tile_cache& get_cache() const { return *cache; }
+
+private:
+
+  std::shared_ptr<tiled_texture_file> file;
+  std::shared_ptr<tile_cache>         cache;
+
+  // The last tile fetched by a lookup, the four texels of a bilinear
+  // sample are usually in the same tile
+  struct tile_lookup
+  {
+    int tx = -1, ty = -1;
+    std::shared_ptr<const texture_tile> tile;
+  };
+
+  // Linear color of texel ([i], [j]) of [level]
+  color texel(tile_lookup& lookup, int level, int i, int j) const
+  {
+    const auto& l = file->levels[level];
+    i = ((i % l.width) + l.width) % l.width;
+    j = std::clamp(j, 0, l.height - 1);
+
+    const int size = file->tile_size;
+    int tx = i / size, ty = j / size;
+    if (tx != lookup.tx || ty != lookup.ty || !lookup.tile)
+    {
+      lookup.tile = cache->get(*file, level, tx, ty);
+      lookup.tx = tx;
+      lookup.ty = ty;
+      if (!lookup.tile)
+        return color(0, 1, 1);
+    }
+
+    const auto* t = &lookup.tile->texels[3 * (std::size_t(j % size) * size + i % size)];
+    color gamma(t[0] / 255.0, t[1] / 255.0, t[2] / 255.0);
+    return gamma * gamma;
+  }
+};
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads consuming a single FIFO task queue.
+// Everything submitted to the same pool shares the workers, so
+// independent jobs (i.e. scanlines of different views) are scheduled
+// together instead of one after the other
+class thread_pool
+{
+public:
+
+  explicit thread_pool(unsigned threads = std::thread::hardware_concurrency())
+  {
+    if (threads == 0)
+      threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+      workers.emplace_back([this] { work(); });
+  }
+
+  ~thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    task_available.notify_all();
+    for (auto& worker : workers)
+      worker.join();
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+  void submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+      ++pending;
+    }
+    task_available.notify_one();
+  }
+
+  // Blocks until the queue is empty and no task is running, whoever
+  // submitted them. Deadlocks if called from a task of the pool, use
+  // parallel_for to wait for a given set of tasks
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [this] { return pending == 0; });
+  }
+
+  // Runs the oldest queued task on the calling thread and returns
+  // true, or returns false if the queue is empty. Lets a thread that
+  // waits for tasks help the workers instead of blocking
+  bool run_one()
+  {
+    std::function<void()> task;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (tasks.empty())
+        return false;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    run(task);
+    return true;
+  }
+
+private:
+
+  std::vector<std::thread>          workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex                        mutex;
+  std::condition_variable           task_available;
+  std::condition_variable           all_done;
+  std::size_t                       pending  = 0;  // queued or running
+  bool                              stopping = false;
+
+  void work()
+  {
+    while (true)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        task_available.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+
+      run(task);
+    }
+  }
+
+  void run(std::function<void()>& task)
+  {
+    task();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pending == 0)
+      all_done.notify_all();
+  }
+};
+
+// Runs fn(i) for every i in [0, count) on [pool] and waits for all
+// of them, but not for other work of the pool. The calling thread
+// runs queued tasks while it waits, so parallel_for may be called
+// from a task of the same pool and from several threads at once
+template <typename Fn>
+void parallel_for(thread_pool& pool, int count, Fn fn)
+{
+  struct completion
+  {
+    std::mutex              mutex;
+    std::condition_variable done;
+    int                     remaining;
+  } state;
+  state.remaining = count;
+
+  for (int i = 0; i < count; ++i)
+  {
+    pool.submit([&fn, &state, i]
+    {
+      fn(i);
+
+      // Notify under the lock, the caller may return and destroy
+      // [state] as soon as it sees the count reach zero
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (--state.remaining == 0)
+        state.done.notify_all();
+    });
+  }
+
+  while (true)
+  {
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (state.remaining == 0)
+        return;
+    }
+    // With the queue empty every task left is already running
+    if (!pool.run_one())
+      break;
+  }
+
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.done.wait(lock, [&state] { return state.remaining == 0; });
+}
@@ -0,0 +1,384 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+#pragma once
+
+#include "image.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Tiled texture files
+// -------------------
+//
+// Image textures are converted once into a MIP pyramid cut in square
+// tiles, so that a render only reads the tiles at the resolution it
+// actually needs. The file layout is:
+//
+//   "RTTX" tile_size levels            (3 x 4 bytes)
+//   width height offset                (4 + 4 + 8 bytes, per level)
+//   tiles of level 0, 1, ...           (row major, tile_size^2 RGB bytes each)
+//
+// Texels are stored in gamma space like the rendered images, tiles on
+// the right and bottom edges are padded by repeating the last texel.
+//
+
+struct texture_level
+{
+  int width, height;
+  int tiles_x, tiles_y;
+  std::uint64_t offset;  // file position of the first tile
+};
+
+class tiled_texture_file
+{
+public:
+
+  explicit tiled_texture_file(const std::string& path)
+    : id(next_id()), in(path, std::ios::binary | std::ios::ate)
+  {
+    const auto file_size = std::uint64_t(std::max<std::streamoff>(0, in.tellg()));
+    in.seekg(0);
+
+    char magic[4];
+    std::uint32_t header[2];
+    if (!in.read(magic, 4) || std::memcmp(magic, "RTTX", 4) != 0
+        || !in.read(reinterpret_cast<char*>(header), sizeof(header))
+        || header[0] == 0 || header[0] > max_tile_size || header[1] > max_levels)
+    {
+      std::clog << "Could not read tiled texture " << path << "\n";
+      return;
+    }
+    tile_size = int(header[0]);
+
+    for (std::uint32_t l = 0; l < header[1]; ++l)
+    {
+      std::uint32_t size[2];
+      texture_level level;
+      in.read(reinterpret_cast<char*>(size), sizeof(size));
+      in.read(reinterpret_cast<char*>(&level.offset), sizeof(level.offset));
+      if (!in || size[0] == 0 || size[1] == 0 || size[0] > max_level_size
+          || size[1] > max_level_size)
+        break;
+
+      level.width   = int(size[0]);
+      level.height  = int(size[1]);
+      level.tiles_x = (level.width  + tile_size - 1) / tile_size;
+      level.tiles_y = (level.height + tile_size - 1) / tile_size;
+
+      // All the tiles of the level must be in the file
+      auto level_bytes = std::uint64_t(level.tiles_x) * level.tiles_y * tile_bytes();
+      if (level.offset > file_size || level_bytes > file_size - level.offset)
+        break;
+      levels.push_back(level);
+    }
+    if (levels.empty() || levels.size() != header[1])
+    {
+      std::clog << "Corrupt tiled texture " << path << "\n";
+      levels.clear();
+    }
+  }
+
+  const std::uint64_t id;  // distinguishes the files sharing a cache
+  int tile_size = 0;
+  std::vector<texture_level> levels;
+
+  bool ok() const { return !levels.empty(); }
+
+  std::size_t tile_bytes() const { return std::size_t(tile_size) * tile_size * 3; }
+
+  // Reads tile ([tx], [ty]) of [level] into [texels], thread safe
+  bool read_tile(int level, int tx, int ty, std::uint8_t* texels)
+  {
+    const auto& l = levels[level];
+    auto position = l.offset + (std::uint64_t(ty) * l.tiles_x + tx) * tile_bytes();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    in.seekg(std::streamoff(position));
+    in.read(reinterpret_cast<char*>(texels), std::streamsize(tile_bytes()));
+    return bool(in);
+  }
+
+private:
+
+  // Limits of the header values, beyond them the file is corrupt
+  static constexpr std::uint32_t max_tile_size  = 4096;
+  static constexpr std::uint32_t max_level_size = 1 << 16;
+  static constexpr std::uint32_t max_levels     = 32;
+
+  std::ifstream in;
+  std::mutex    mutex;
+
+  static std::uint64_t next_id()
+  {
+    static std::atomic<std::uint64_t> counter{0};
+    return counter++;
+  }
+};
+
+// Converts [source] to a tiled MIP pyramid and writes it to [path].
+// Each level is a 2x2 box filtered version of the previous one, down
+// to a single texel
+inline bool make_tiled_texture(const image& source, const std::string& path,
+                               int tile_size = 64)
+{
+  std::vector<image> pyramid{ source };
+  while (pyramid.back().width > 1 || pyramid.back().height > 1)
+  {
+    const image& fine = pyramid.back();
+    image coarse(std::max(1, (fine.width + 1) / 2), std::max(1, (fine.height + 1) / 2));
+    for (int j = 0; j < coarse.height; ++j)
+    {
+      for (int i = 0; i < coarse.width; ++i)
+      {
+        color sum(0, 0, 0);
+        for (int dj = 0; dj < 2; ++dj)
+          for (int di = 0; di < 2; ++di)
+            sum += fine.row(std::min(2 * j + dj, fine.height - 1))
+                           [std::min(2 * i + di, fine.width - 1)];
+        coarse.row(j)[i] = 0.25 * sum;
+      }
+    }
+    pyramid.push_back(std::move(coarse));
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+  {
+    std::clog << "Could not open " << path << " for writing\n";
+    return false;
+  }
+
+  std::uint32_t header[2] = { std::uint32_t(tile_size), std::uint32_t(pyramid.size()) };
+  out.write("RTTX", 4);
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  const std::uint64_t tile_bytes = std::uint64_t(tile_size) * tile_size * 3;
+  std::uint64_t offset = 4 + sizeof(header) + pyramid.size() * 16;
+  for (const auto& level : pyramid)
+  {
+    std::uint32_t size[2] = { std::uint32_t(level.width), std::uint32_t(level.height) };
+    out.write(reinterpret_cast<const char*>(size), sizeof(size));
+    out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    std::uint64_t tiles_x = (level.width  + tile_size - 1) / tile_size;
+    std::uint64_t tiles_y = (level.height + tile_size - 1) / tile_size;
+    offset += tiles_x * tiles_y * tile_bytes;
+  }
+
+  static const interval intensity(0.000, 0.999);
+  std::vector<std::uint8_t> texels(tile_bytes);
+  for (const auto& level : pyramid)
+  {
+    for (int ty = 0; ty * tile_size < level.height; ++ty)
+    {
+      for (int tx = 0; tx * tile_size < level.width; ++tx)
+      {
+        auto* texel = texels.data();
+        for (int j = 0; j < tile_size; ++j)
+        {
+          const color* row = level.row(std::min(ty * tile_size + j, level.height - 1));
+          for (int i = 0; i < tile_size; ++i)
+          {
+            const color& c = row[std::min(tx * tile_size + i, level.width - 1)];
+            for (int k = 0; k < 3; ++k)
+              *texel++ = std::uint8_t(256 * intensity.clamp(linear_to_gamma(c[k])));
+          }
+        }
+        out.write(reinterpret_cast<const char*>(texels.data()), std::streamsize(tile_bytes));
+      }
+    }
+  }
+
+  return bool(out);
+}
+
+//
+// Tile cache
+// ----------
+//
+// A least recently used cache of texture tiles with a memory cap,
+// shared by all the image textures and all the render threads. It is
+// split in shards with their own lock and an equal share of the
+// memory, so that concurrent lookups rarely wait for each other.
+//
+// A shard never holds more than its share, so the resident tiles
+// never exceed the cap, which must leave room for at least one tile
+// in each shard (see holds()). Tiles are handed out as shared
+// pointers, a tile evicted while a thread is still sampling it stays
+// alive until that thread is done.
+//
+
+struct texture_tile
+{
+  std::vector<std::uint8_t> texels;  // tile_size^2 RGB, gamma space
+};
+
+class tile_cache
+{
+public:
+
+  struct statistics
+  {
+    std::uint64_t hits       = 0;
+    std::uint64_t misses     = 0;
+    std::uint64_t evictions  = 0;
+    std::size_t   bytes      = 0;  // currently resident
+    std::size_t   peak_bytes = 0;
+  };
+
+  explicit tile_cache(std::size_t max_bytes = std::size_t(256) << 20)
+    : max_bytes(max_bytes) {}
+
+  std::size_t capacity() const { return max_bytes; }
+
+  // True if tiles of [tile_bytes] fit in the share of a shard
+  bool holds(std::size_t tile_bytes) const { return tile_bytes <= max_bytes / shard_count; }
+
+  // Returns tile ([tx], [ty]) of [level] of [file], reading it from
+  // disk if it is not resident. Returns nullptr if the read fails
+  std::shared_ptr<const texture_tile> get(tiled_texture_file& file, int level,
+                                          int tx, int ty)
+  {
+    const tile_key key{ file.id, std::uint32_t(level), std::uint32_t(tx), std::uint32_t(ty) };
+    shard& s = shards[(tile_key_hash()(key) * 0x9E3779B97F4A7C15ull) >> 60];
+
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      auto found = s.index.find(key);
+      if (found != s.index.end())
+      {
+        s.lru.splice(s.lru.begin(), s.lru, found->second);
+        ++s.stats.hits;
+        assert(found->second->tile->texels.size() == file.tile_bytes());
+        return found->second->tile;
+      }
+      ++s.stats.misses;
+    }
+
+    // Read outside of the lock, two threads missing the same tile may
+    // both read it, the second one then uses the tile of the first
+    auto tile = std::make_shared<texture_tile>();
+    tile->texels.resize(file.tile_bytes());
+    if (!file.read_tile(level, tx, ty, tile->texels.data()))
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto found = s.index.find(key);
+    if (found != s.index.end())
+    {
+      assert(found->second->tile->texels.size() == file.tile_bytes());
+      return found->second->tile;
+    }
+
+    // A tile bigger than the share is never kept
+    if (tile->texels.size() > max_bytes / shard_count)
+      return tile;
+
+    s.lru.push_front({ key, tile });
+    s.index[key] = s.lru.begin();
+    s.stats.bytes += tile->texels.size();
+
+    const std::size_t shard_bytes = max_bytes / shard_count;
+    while (s.stats.bytes > shard_bytes)
+    {
+      s.stats.bytes -= s.lru.back().tile->texels.size();
+      s.index.erase(s.lru.back().key);
+      s.lru.pop_back();
+      ++s.stats.evictions;
+    }
+    s.stats.peak_bytes = std::max(s.stats.peak_bytes, s.stats.bytes);
+
+    return tile;
+  }
+
+  // Totals of all the shards. The peak is the sum of the peaks of the
+  // shards, an upper bound of the real peak
+  statistics stats() const
+  {
+    statistics total;
+    for (const auto& s : shards)
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      total.hits       += s.stats.hits;
+      total.misses     += s.stats.misses;
+      total.evictions  += s.stats.evictions;
+      total.bytes      += s.stats.bytes;
+      total.peak_bytes += s.stats.peak_bytes;
+    }
+    return total;
+  }
+
+  void print_stats(std::ostream& out) const
+  {
+    auto s = stats();
+    auto lookups = s.hits + s.misses;
+    out << "Tile cache: " << s.hits << " hits, " << s.misses << " misses ("
+        << (lookups ? 100.0 * s.hits / lookups : 0.0) << "% hit rate), "
+        << s.evictions << " evictions, " << (s.bytes >> 10) << " KiB resident, "
+        << (s.peak_bytes >> 10) << " KiB peak of " << (max_bytes >> 10) << " KiB\n";
+  }
+
+private:
+
+  static constexpr std::size_t shard_count = 16;
+
+  struct tile_key
+  {
+    std::uint64_t file;
+    std::uint32_t level, tx, ty;
+
+    bool operator==(const tile_key& other) const
+    {
+      return file == other.file && level == other.level && tx == other.tx && ty == other.ty;
+    }
+  };
+
+  struct tile_key_hash
+  {
+    std::size_t operator()(const tile_key& k) const
+    {
+      std::uint64_t h = k.file * 0x9E3779B97F4A7C15ull;
+      h = (h ^ k.level) * 0xBF58476D1CE4E5B9ull;
+      h = (h ^ (std::uint64_t(k.ty) << 32 | k.tx)) * 0x94D049BB133111EBull;
+      return std::size_t(h ^ (h >> 31));
+    }
+  };
+
+  struct entry
+  {
+    tile_key key;
+    std::shared_ptr<const texture_tile> tile;
+  };
+
+  struct shard
+  {
+    mutable std::mutex mutex;
+    std::list<entry> lru;  // most recently used first
+    std::unordered_map<tile_key, std::list<entry>::iterator, tile_key_hash> index;
+    statistics stats;
+  };
+
+  std::size_t max_bytes;
+  shard shards[shard_count];
+};
+
+// The cache used by image textures unless they are given another one
+inline std::shared_ptr<tile_cache> default_tile_cache()
+{
+  static auto cache = std::make_shared<tile_cache>();
+  return cache;
+}
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <limits>
 #include <random>
 
@@ -16,11 +17,26 @@ inline double degrees_to_radians(double degrees)
   return degrees * pi / 180.0;
 }
 
+// Each thread owns its generator, so worker threads never share
+// random state
+inline std::mt19937& random_generator()
+{
+  static thread_local std::mt19937 generator;
+  return generator;
+}
+
+// Restart the random stream of the calling thread from [seed]. The
+// renderer reseeds per scanline so that images do not depend on
+// which thread rendered what
+inline void random_seed(std::uint32_t seed)
+{
+  random_generator().seed(seed);
+}
+
 inline double random_double()
 {
-  static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-  static std::mt19937 generator;
-  return distribution(generator);
+  static thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  return distribution(random_generator());
 }
 
 inline double random_double(double min, double max)
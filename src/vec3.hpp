@@ -5,38 +5,67 @@
 
 #pragma once
 
+#include "utils.hpp"
+#include "fast_math.hpp"
+
 #include <cmath>
 #include <iostream>
 
+// With RAYTRACER_SIMD (cmake -DENABLE_SIMD=ON) and an AVX2 target the
+// vectors are padded to four lanes and the arithmetic is done on the
+// whole register. The API is the same for both backends
+#if defined(RAYTRACER_SIMD) && defined(__AVX2__)
+#define RAYTRACER_VEC3_SIMD
+#include <immintrin.h>
+#endif
+
 class vec3
 {
 public:
+#ifdef RAYTRACER_VEC3_SIMD
+  alignas(32) double e[4];  // the fourth lane is padding, always zero
+
+  vec3() : e{0,0,0,0} {}
+  vec3(double e0, double e1, double e2) : e{e0,e1,e2,0} {}
+  explicit vec3(__m256d v) { _mm256_store_pd(e, v); }
+
+  __m256d simd() const { return _mm256_load_pd(e); }
+#else
   double e[3];
 
   vec3() : e{0,0,0} {}
   vec3(double e0, double e1, double e2) : e{e0,e1,e2} {}
+#endif
 
   double x() const { return e[0]; }
   double y() const { return e[1]; }
   double z() const { return e[2]; }
 
-  vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
+  vec3 operator-() const;
   double operator[](int i) const { return e[i]; }
   double &operator[](int i) { return e[i]; }
 
   vec3 &operator+=(const vec3& v)
   {
+#ifdef RAYTRACER_VEC3_SIMD
+    _mm256_store_pd(e, _mm256_add_pd(simd(), v.simd()));
+#else
     e[0] += v.e[0];
     e[1] += v.e[1];
     e[2] += v.e[2];
+#endif
     return *this;
   }
 
   vec3& operator*=(double t)
   {
+#ifdef RAYTRACER_VEC3_SIMD
+    _mm256_store_pd(e, _mm256_mul_pd(simd(), _mm256_set1_pd(t)));
+#else
     e[0] *= t;
     e[1] *= t;
     e[2] *= t;
+#endif
     return *this;
   }
 
@@ -48,10 +77,7 @@ public:
     return std::sqrt(length_squared());
   }
 
-  double length_squared() const
-  {
-    return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
-  }
+  double length_squared() const;
 
   bool near_zero() const
   {
@@ -78,6 +104,56 @@ inline std::ostream& operator<<(std::ostream& out, const vec3& v)
   return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
+#ifdef RAYTRACER_VEC3_SIMD
+
+inline vec3 operator+(const vec3& u, const vec3& v)
+{
+  return vec3(_mm256_add_pd(u.simd(), v.simd()));
+}
+
+inline vec3 operator-(const vec3& u, const vec3& v)
+{
+  return vec3(_mm256_sub_pd(u.simd(), v.simd()));
+}
+
+inline vec3 operator*(const vec3& u, const vec3& v)
+{
+  return vec3(_mm256_mul_pd(u.simd(), v.simd()));
+}
+
+inline vec3 operator*(double t, const vec3& v)
+{
+  return vec3(_mm256_mul_pd(_mm256_set1_pd(t), v.simd()));
+}
+
+inline vec3 vec3::operator-() const
+{
+  return vec3(_mm256_sub_pd(_mm256_setzero_pd(), simd()));
+}
+
+inline double dot(const vec3& u, const vec3& v)
+{
+  // The padding lanes are zero, so the sum of all four products is
+  // the dot product
+  __m256d products = _mm256_mul_pd(u.simd(), v.simd());
+  __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(products),
+                           _mm256_extractf128_pd(products, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+inline vec3 cross(const vec3& u, const vec3& v)
+{
+  // u.yzx * v.zxy - u.zxy * v.yzx, the padding lane stays zero
+  __m256d a = u.simd(), b = v.simd();
+  __m256d a_yzx = _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 0, 2, 1));
+  __m256d b_yzx = _mm256_permute4x64_pd(b, _MM_SHUFFLE(3, 0, 2, 1));
+  __m256d a_zxy = _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 1, 0, 2));
+  __m256d b_zxy = _mm256_permute4x64_pd(b, _MM_SHUFFLE(3, 1, 0, 2));
+  return vec3(_mm256_sub_pd(_mm256_mul_pd(a_yzx, b_zxy), _mm256_mul_pd(a_zxy, b_yzx)));
+}
+
+#else
+
 inline vec3 operator+(const vec3& u, const vec3& v)
 {
   return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
@@ -98,14 +174,9 @@ inline vec3 operator*(double t, const vec3& v)
   return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
 
-inline vec3 operator*(const vec3&v, double t)
+inline vec3 vec3::operator-() const
 {
-  return t * v;
-}
-
-inline vec3 operator/(const vec3& v, double t)
-{
-  return (1/t) * v;
+  return vec3(-e[0], -e[1], -e[2]);
 }
 
 inline double dot(const vec3& u, const vec3& v)
@@ -122,23 +193,62 @@ inline vec3 cross(const vec3& u, const vec3& v)
               u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
+#endif
+
+inline double vec3::length_squared() const
+{
+  return dot(*this, *this);
+}
+
+inline vec3 operator*(const vec3&v, double t)
+{
+  return t * v;
+}
+
+inline vec3 operator/(const vec3& v, double t)
+{
+  return (1/t) * v;
+}
+
 inline vec3 unit_vector(const vec3& v)
 {
+#ifdef RAYTRACER_FAST_MATH
+  return fast_rsqrt(v.length_squared()) * v;
+#else
   return v / v.length();
+#endif
 }
 
 inline vec3 random_in_unit_disk()
 {
+#ifdef RAYTRACER_FAST_MATH
+  // Map two uniform numbers to polar coordinates, the square root
+  // spreads the radius uniformly over the area
+  auto r = std::sqrt(random_double());
+  double s, c;
+  fast_sincos(2 * pi * random_double(), s, c);
+  return vec3(r * c, r * s, 0);
+#else
   while (true)
   {
     auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
     if (p.length_squared() < 1)
       return p;
   }
+#endif
 }
 
 inline vec3 random_unit_vector()
 {
+#ifdef RAYTRACER_FAST_MATH
+  // Uniform height and angle around the Y axis are uniform on the
+  // sphere (Archimedes' hat-box theorem), no rejection needed
+  auto y = 1 - 2 * random_double();
+  auto r = std::sqrt(1 - y * y);
+  double s, c;
+  fast_sincos(2 * pi * random_double(), s, c);
+  return vec3(r * c, y, r * s);
+#else
   while (true)
   {
     auto p = vec3::random(-1, 1);
@@ -146,6 +256,7 @@ inline vec3 random_unit_vector()
     if (1e-160 < lensq && lensq <= 1)
       return p / sqrt(lensq); // normalize
   }
+#endif
 }
 
 inline vec3 random_on_hemisphere(const vec3& normal)
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Minimal assertions for the module tests. A failed check is reported
+// and counted, and the test returns check_failures() from main
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+inline int& check_failures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+inline void check(bool condition, const std::string& what)
+{
+  if (condition)
+    return;
+  std::cout << "FAIL: " << what << "\n";
+  ++check_failures();
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Small deterministic scenes rendered by the regression tests
+
+#pragma once
+
+#include "raytracer.hpp"
+
+// The camera shared by the test scenes, small and cheap to render
+inline camera test_camera()
+{
+  camera cam;
+  cam.aspect_ratio      = 16.0 / 9.0;
+  cam.image_width       = 96;
+  cam.samples_per_pixel = 64;
+  cam.max_depth         = 16;
+  cam.seed              = 1;
+  return cam;
+}
+
+// Ground, a diffuse, a glass and a metal sphere
+inline hittable_list materials_scene(camera& cam)
+{
+  hittable_list world;
+  world.add(std::make_shared<sphere>(point3(0, -100.5, -1), 100,
+                                     std::make_shared<lambertian>(color(0.8, 0.8, 0.0))));
+  world.add(std::make_shared<sphere>(point3(0, 0, -1.2), 0.5,
+                                     std::make_shared<lambertian>(color(0.1, 0.2, 0.5))));
+  world.add(std::make_shared<sphere>(point3(-1, 0, -1), 0.5,
+                                     std::make_shared<dielectric>(1.5)));
+  world.add(std::make_shared<sphere>(point3(-1, 0, -1), 0.4,
+                                     std::make_shared<dielectric>(1.0 / 1.5)));
+  world.add(std::make_shared<sphere>(point3(1, 0, -1), 0.5,
+                                     std::make_shared<metal>(color(0.8, 0.6, 0.2), 0.3)));
+
+  cam.vfov     = 50;
+  cam.lookfrom = point3(-2, 2, 1);
+  cam.lookat   = point3(0, 0, -1);
+  cam.defocus_angle = 2.0;
+  cam.focus_dist    = 3.4;
+  return world;
+}
+
+// The scene of main.cpp, with the same camera, at a fraction of the
+// spheres. Calls add(center, radius, material) for every sphere
+template <typename Add>
+void main_scene(camera& cam, Add add)
+{
+  random_seed(42);
+  add(point3(0,-1000,0), 1000, std::make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+
+  for (int a = -5; a < 5; a++)
+  {
+    for (int b = -5; b < 5; b++)
+    {
+      auto choose_mat = random_double();
+      point3 center(2 * a + 1.8*random_double(), 0.2, 2 * b + 1.8*random_double());
+      if ((center - point3(4, 0.2, 0)).length() <= 0.9)
+        continue;
+
+      if (choose_mat < 0.8)
+        add(center, 0.2, std::make_shared<lambertian>(color::random() * color::random()));
+      else if (choose_mat < 0.95)
+        add(center, 0.2, std::make_shared<metal>(color::random(0.5, 1), random_double(0, 0.5)));
+      else
+        add(center, 0.2, std::make_shared<dielectric>(1.5));
+    }
+  }
+
+  add(point3(0, 1, 0), 1.0, std::make_shared<dielectric>(1.5));
+  add(point3(-4, 1, 0), 1.0, std::make_shared<lambertian>(color(0.4, 0.2, 0.1)));
+  add(point3(4, 1, 0), 1.0, std::make_shared<metal>(color(0.7, 0.6, 0.5), 0.0));
+
+  cam.vfov     = 20;
+  cam.lookfrom = point3(13,2,3);
+  cam.lookat   = point3(0,0,0);
+  cam.defocus_angle = 0.6;
+  cam.focus_dist    = 10.0;
+}
+
+// A procedural checker ground and a sphere with an image texture. The
+// texture is generated and tiled in the working directory, through a
+// cache smaller than the texture
+inline hittable_list textures_scene(camera& cam, std::shared_ptr<tile_cache> cache)
+{
+  image stripes(256, 128);
+  for (int j = 0; j < stripes.height; ++j)
+    for (int i = 0; i < stripes.width; ++i)
+      stripes.row(j)[i] = ((i / 16 + j / 16) % 2) ? color(0.9, 0.3, 0.1) : color(0.1, 0.3, 0.9);
+  make_tiled_texture(stripes, "test_stripes.rttx", 32);
+
+  hittable_list world;
+  auto checker = std::make_shared<checker_texture>(0.32, color(.2, .3, .1), color(.9, .9, .9));
+  world.add(std::make_shared<sphere>(point3(0, -1000, 0), 1000,
+                                     std::make_shared<lambertian>(checker)));
+  auto stripes_texture = std::make_shared<image_texture>("test_stripes.rttx", cache);
+  world.add(std::make_shared<sphere>(point3(0, 1, 0), 1,
+                                     std::make_shared<lambertian>(stripes_texture)));
+
+  cam.vfov     = 30;
+  cam.lookfrom = point3(5, 2, 3);
+  cam.lookat   = point3(0, 1, 0);
+  return world;
+}
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Compares intersect_batch and occluded_batch of raytracer_core on
+// the bvh of the main test scene with single queries on the plain
+// list, on the default pool, on a given pool and from inside a task
+// of that pool
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "batch.hpp"
+#include "check.hpp"
+#include "scenes.hpp"
+
+struct batch_data
+{
+  std::vector<double> origins, directions, t_min, t_max;
+  ray_batch rays;
+
+  std::vector<double>        t, normals;
+  std::vector<std::int32_t>  primitives;
+  std::vector<std::uint64_t> occluded;
+  hit_batch hits;
+
+  explicit batch_data(std::size_t count)
+    : origins(3 * count), directions(3 * count), t_min(count, 0.001), t_max(count),
+      t(count), normals(3 * count), primitives(count), occluded((count + 63) / 64)
+  {
+    // Rays from above the scene towards the ground, half of them short
+    // enough to stop before it, like shadow rays. The count is not a
+    // multiple of the task size nor of the occlusion words
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      auto origin    = point3(random_double(-12, 12), random_double(0.5, 4), random_double(-12, 12));
+      auto direction = vec3(random_double(-1, 1), -1, random_double(-1, 1));
+      for (int k = 0; k < 3; ++k)
+      {
+        origins[3 * i + k]    = origin[k];
+        directions[3 * i + k] = direction[k];
+      }
+      t_max[i] = (i % 2) ? infinity : random_double(0.5, 4);
+    }
+    rays = { origins.data(), directions.data(), t_min.data(), t_max.data(), count };
+    hits = { t.data(), normals.data(), primitives.data() };
+  }
+
+  // Rays whose batch results differ from a single query on [list]
+  std::size_t mismatches(const hittable_list& list) const
+  {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < rays.count; ++i)
+    {
+      ray r(point3(origins[3 * i], origins[3 * i + 1], origins[3 * i + 2]),
+            vec3(directions[3 * i], directions[3 * i + 1], directions[3 * i + 2]));
+      hit_record rec;
+      bool hit = list.hit(r, interval(t_min[i], t_max[i]), rec);
+      bool bit = (occluded[i / 64] >> (i % 64)) & 1;
+
+      bool same = hit == bit && hit == (primitives[i] >= 0) && hit == (t[i] != infinity);
+      if (same && hit)
+      {
+        vec3 outward = rec.front_face ? rec.normal : -rec.normal;
+        same = rec.t == t[i] && rec.primitive == primitives[i]
+          && std::fabs(outward.x() - normals[3 * i]) < 1e-12
+          && std::fabs(outward.y() - normals[3 * i + 1]) < 1e-12
+          && std::fabs(outward.z() - normals[3 * i + 2]) < 1e-12;
+      }
+      count += !same;
+    }
+    return count;
+  }
+};
+
+int main(void)
+{
+  camera cam = test_camera();
+  hittable_list list;
+  main_scene(cam, [&](const point3& center, double radius, std::shared_ptr<material> mat)
+  {
+    list.add(std::make_shared<sphere>(center, radius, mat));
+  });
+  bvh world(list);
+
+  random_seed(1);
+  batch_data data(10000 + 37);
+
+  intersect_batch(world, data.rays, data.hits);
+  occluded_batch(world, data.rays, data.occluded.data());
+  auto mismatches = data.mismatches(list);
+  check(mismatches == 0, std::to_string(mismatches) + " rays differ on the default pool");
+
+  thread_pool pool(2);
+  std::fill(data.t.begin(), data.t.end(), 0);
+  std::fill(data.occluded.begin(), data.occluded.end(), 0);
+  parallel_for(pool, 1, [&](int)
+  {
+    intersect_batch(world, data.rays, data.hits, pool);
+    occluded_batch(world, data.rays, data.occluded.data(), pool);
+  });
+  mismatches = data.mismatches(list);
+  check(mismatches == 0, std::to_string(mismatches) + " rays differ inside a pool task");
+
+  // The optional outputs may be left out
+  std::vector<double> t(data.rays.count);
+  intersect_batch(world, data.rays, hit_batch{ t.data(), nullptr, nullptr }, pool);
+  check(t == data.t, "distances change without normals and primitives");
+
+  // An empty batch touches nothing
+  intersect_batch(world, ray_batch{}, hit_batch{});
+  occluded_batch(world, ray_batch{}, nullptr);
+
+  return check_failures();
+}
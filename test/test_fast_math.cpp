@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Checks the error of the fast math kernels against the bounds
+// documented in fast_math.hpp, over random samples of their ranges
+// and at the edges of those ranges
+
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "check.hpp"
+
+// Largest error of [fast] against [reference] over [inputs], checked
+// against [bound]
+template <typename Reference, typename Fast, typename Error>
+void check_bound(const std::string& name, double bound, const std::vector<double>& inputs,
+                 Reference reference, Fast fast, Error error)
+{
+  double max_error = 0;
+  for (auto x : inputs)
+    max_error = std::max(max_error, error(fast(x), reference(x)));
+  std::ostringstream what;
+  what << name << ": max error " << max_error << " over the bound " << bound;
+  check(max_error <= bound, what.str());
+}
+
+// [edges] followed by a million samples of [sample]
+template <typename Sample>
+std::vector<double> inputs(Sample sample, std::vector<double> edges)
+{
+  for (int i = 0; i < 1000000; ++i)
+    edges.push_back(sample());
+  return edges;
+}
+
+int main(void)
+{
+  random_seed(0);
+
+  auto relative = [](double a, double b) { return std::fabs(a / b - 1); };
+  auto absolute = [](double a, double b) { return std::fabs(a - b); };
+
+  check_bound("rsqrt", 5e-11,
+              inputs([] { return std::exp2(random_double(-100, 100)); },
+                     { DBL_MIN, 0.25, 1, 2, 3, 1e100, DBL_MAX }),
+              [](double x) { return 1 / std::sqrt(x); },
+              [](double x) { return fast_rsqrt(x); }, relative);
+
+  check_bound("ipow<5>", 1e-15,
+              inputs([] { return random_double(0, 2); }, { 1e-3, 0.5, 1, 2 }),
+              [](double x) { return std::pow(x, 5); },
+              [](double x) { return ipow<5>(x); }, relative);
+  check(ipow<0>(3.0) == 1 && ipow<1>(3.0) == 3 && ipow<2>(3.0) == 9 && ipow<3>(-2.0) == -8,
+        "ipow of small powers is not exact");
+
+  std::vector<double> angle_edges = { -1e3, 1e3, 0, -0.0 };
+  for (int k = -8; k <= 8; ++k)
+    angle_edges.push_back(k * pi / 4);
+  auto angles = inputs([] { return random_double(-1e3, 1e3); }, angle_edges);
+  check_bound("sincos (sin)", 2e-10, angles, [](double x) { return std::sin(x); },
+              [](double x) { double s, c; fast_sincos(x, s, c); return s; }, absolute);
+  check_bound("sincos (cos)", 2e-10, angles, [](double x) { return std::cos(x); },
+              [](double x) { double s, c; fast_sincos(x, s, c); return c; }, absolute);
+
+  check_bound("tan", 5e-10,
+              inputs([] { return random_double(-1.5, 1.5); }, { -1.5, -1e-8, 1e-8, 1.5 }),
+              [](double x) { return std::tan(x); },
+              [](double x) { return fast_tan(x); }, relative);
+
+  return check_failures();
+}
@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Rendering regression tests
+//
+// Usage: raytracer_tests <scene> [--update]
+//
+// Renders one of the test scenes and compares it with its golden
+// image in GOLDEN_DIR. The images are compared in gamma space, both
+// at full resolution and downsampled 4x4, which averages away most of
+// the sampling noise and keeps the structure. On failure the render
+// and an amplified difference image are written to the working
+// directory.
+//
+// When built with RAYTRACER_CHECK_THROUGHPUT, the rays per second of
+// the render are also compared with those of a calibration kernel run
+// on the same machine, and the ratio must stay above a fraction of
+// the ratio recorded with the golden image.
+//
+// --update overwrites the golden image and the recorded ratio.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "raytracer.hpp"
+#include "scenes.hpp"
+
+#ifndef GOLDEN_DIR
+#define GOLDEN_DIR "test/golden"
+#endif
+
+// Tolerances, in gamma space [0, 1]
+constexpr double max_rmse             = 0.06;  // full resolution
+constexpr double max_downsampled_rmse = 0.015; // 4x4 box filtered
+
+// The throughput may drop to this fraction of the recorded one
+constexpr double min_throughput_fraction = 0.5;
+
+// Forwards to [world] and counts the intersection queries
+template <typename World>
+struct counting_world
+{
+  const World& world;
+  mutable std::atomic<std::uint64_t> rays{0};
+
+  bool hit(const ray& r, interval ray_t, hit_record& rec) const
+  {
+    rays.fetch_add(1, std::memory_order_relaxed);
+    return world.hit(r, ray_t, rec);
+  }
+};
+
+struct render_result
+{
+  image  framebuffer;
+  double rays_per_second = 0;
+  bool   checks_passed   = true;  // checks of the scene besides the image
+};
+
+// Renders [world] through [cam] on a single worker, so that the
+// throughput compares with the single threaded calibration. Keeps the
+// fastest of a few runs
+template <typename World>
+render_result render(camera cam, const World& world)
+{
+  render_result result;
+  thread_pool pool(1);
+  for (int run = 0; run < 3; ++run)
+  {
+    counting_world<World> counted{ world };
+    auto start = std::chrono::steady_clock::now();
+    cam.render(counted, pool, result.framebuffer);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.rays_per_second = std::max(result.rays_per_second, counted.rays / elapsed.count());
+  }
+  return result;
+}
+
+// Queries per second of a fixed intersection workload, the unit of
+// the throughput floors
+double calibration_rate()
+{
+  random_seed(7);
+  hittable_list world;
+  auto mat = std::make_shared<lambertian>(color(0.5, 0.5, 0.5));
+  for (int i = 0; i < 64; ++i)
+    world.add(std::make_shared<sphere>(vec3::random(-4, 4), random_double(0.1, 0.5), mat));
+
+  std::vector<ray> rays;
+  for (int i = 0; i < 100000; ++i)
+    rays.emplace_back(vec3::random(-8, 8), vec3::random(-1, 1));
+
+  double best = 0;
+  for (int run = 0; run < 3; ++run)
+  {
+    int hits = 0;
+    hit_record rec;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& r : rays)
+      hits += world.hit(r, interval(0.001, infinity), rec);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    volatile int sink = hits;
+    (void)sink;
+    best = std::max(best, rays.size() / elapsed.count());
+  }
+  return best;
+}
+
+std::function<render_result()> find_scene(const std::string& name)
+{
+  if (name == "materials")
+    return []
+    {
+      camera cam = test_camera();
+      auto world = materials_scene(cam);
+      return render(cam, world);
+    };
+
+  // Same golden image as materials, guiding must not bias the render
+  if (name == "materials_guided")
+    return []
+    {
+      camera cam = test_camera();
+      cam.path_guiding = true;
+      auto world = materials_scene(cam);
+      return render(cam, world);
+    };
+
+  if (name == "main_scene")
+    return []
+    {
+      camera cam = test_camera();
+      hittable_list list;
+      main_scene(cam, [&](const point3& center, double radius, std::shared_ptr<material> mat)
+      {
+        list.add(std::make_shared<sphere>(center, radius, mat));
+      });
+      return render(cam, bvh(list));
+    };
+
+  // Same golden image as main_scene, through the closed world path
+  if (name == "main_scene_static")
+    return []
+    {
+      camera cam = test_camera();
+      static_scene<sphere> world;
+      main_scene(cam, [&](const point3& center, double radius, std::shared_ptr<material> mat)
+      {
+        world.add(sphere(center, radius, mat));
+      });
+      return render(cam, world);
+    };
+
+  if (name == "textures")
+    return []
+    {
+      camera cam = test_camera();
+      auto cache = std::make_shared<tile_cache>(96 << 10);
+      auto world = textures_scene(cam, cache);
+      auto result = render(cam, world);
+
+      // The cache is smaller than the texture, it must have evicted
+      // tiles and stayed under its cap
+      cache->print_stats(std::cout);
+      auto stats = cache->stats();
+      if (stats.misses == 0 || stats.hits < stats.misses || stats.evictions == 0
+          || stats.peak_bytes > cache->capacity())
+      {
+        std::cout << "FAIL: unexpected tile cache statistics\n";
+        result.checks_passed = false;
+      }
+      return result;
+    };
+
+  return nullptr;
+}
+
+// Gamma space channels of [img], downsampled by [factor]
+std::vector<double> gamma_channels(const image& img, int factor)
+{
+  int w = img.width / factor, h = img.height / factor;
+  std::vector<double> channels;
+  for (int j = 0; j < h; ++j)
+  {
+    for (int i = 0; i < w; ++i)
+    {
+      for (int c = 0; c < 3; ++c)
+      {
+        double sum = 0;
+        for (int dj = 0; dj < factor; ++dj)
+          for (int di = 0; di < factor; ++di)
+            sum += interval(0, 1).clamp(linear_to_gamma(img.row(j * factor + dj)[i * factor + di][c]));
+        channels.push_back(sum / (factor * factor));
+      }
+    }
+  }
+  return channels;
+}
+
+double rmse(const image& a, const image& b, int factor)
+{
+  auto ca = gamma_channels(a, factor), cb = gamma_channels(b, factor);
+  double sum = 0;
+  for (std::size_t k = 0; k < ca.size(); ++k)
+    sum += (ca[k] - cb[k]) * (ca[k] - cb[k]);
+  return std::sqrt(sum / ca.size());
+}
+
+// Absolute difference of [a] and [b] in gamma space, amplified
+image difference(const image& a, const image& b)
+{
+  image diff(a.width, a.height);
+  for (std::size_t k = 0; k < diff.pixels.size(); ++k)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      double d = std::fabs(linear_to_gamma(a.pixels[k][c]) - linear_to_gamma(b.pixels[k][c]));
+      diff.pixels[k][c] = std::min(1.0, 4 * d) * std::min(1.0, 4 * d);  // back to linear
+    }
+  }
+  return diff;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <scene> [--update]\n";
+    return 2;
+  }
+
+  std::string name = argv[1];
+  bool update = argc > 2 && std::strcmp(argv[2], "--update") == 0;
+
+  auto scene = find_scene(name);
+  if (!scene)
+  {
+    std::cerr << "Unknown scene " << name << "\n";
+    return 2;
+  }
+
+  std::string golden_name = name;
+  if (name == "main_scene_static")
+    golden_name = "main_scene";
+  else if (name == "materials_guided")
+    golden_name = "materials";
+  std::string golden_path = std::string(GOLDEN_DIR) + "/" + golden_name + ".ppm";
+  std::string ratio_path  = std::string(GOLDEN_DIR) + "/" + name + ".throughput";
+
+  auto result = scene();
+  auto calibration = calibration_rate();
+  auto ratio = result.rays_per_second / calibration;
+  std::cout << name << ": " << result.rays_per_second << " rays/s, "
+            << ratio << "x the calibration kernel\n";
+
+  if (update)
+  {
+    std::ofstream(ratio_path) << ratio << "\n";
+    return (golden_name != name || result.framebuffer.save_ppm(golden_path)) ? 0 : 1;
+  }
+
+  bool passed = result.checks_passed;
+
+  image golden;
+  if (!golden.load_ppm(golden_path))
+    return 1;
+  if (golden.width != result.framebuffer.width || golden.height != result.framebuffer.height)
+  {
+    std::cout << "FAIL: golden image is " << golden.width << "x" << golden.height << "\n";
+    return 1;
+  }
+
+  auto full        = rmse(result.framebuffer, golden, 1);
+  auto downsampled = rmse(result.framebuffer, golden, 4);
+  std::cout << "rmse " << full << " (max " << max_rmse << "), downsampled "
+            << downsampled << " (max " << max_downsampled_rmse << ")\n";
+
+  if (full > max_rmse || downsampled > max_downsampled_rmse)
+  {
+    std::cout << "FAIL: image differs from " << golden_path << ", see "
+              << name << "_actual.ppm and " << name << "_diff.ppm\n";
+    result.framebuffer.save_ppm(name + "_actual.ppm");
+    difference(result.framebuffer, golden).save_ppm(name + "_diff.ppm");
+    passed = false;
+  }
+
+#ifdef RAYTRACER_CHECK_THROUGHPUT
+  double recorded = 0;
+  if (std::ifstream(ratio_path) >> recorded)
+  {
+    double floor = min_throughput_fraction * recorded;
+    std::cout << "throughput floor " << floor << "x the calibration kernel\n";
+    if (ratio < floor)
+    {
+      std::cout << "FAIL: throughput below the floor\n";
+      passed = false;
+    }
+  }
+#endif
+
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Renders a stereo pair and a cube map of the materials scene with
+// render_views, checks the files written, the eye placement and the
+// orientation of the faces
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "check.hpp"
+#include "scenes.hpp"
+
+bool near(const vec3& a, const vec3& b)
+{
+  return (a - b).length() < 1e-12;
+}
+
+int main(void)
+{
+  camera cam = test_camera();
+  cam.image_width       = 32;
+  cam.samples_per_pixel = 4;
+  auto world = materials_scene(cam);
+  cam.initialize();
+
+  const double separation = 0.065;
+  auto eyes = stereo_pair(cam, separation);
+  check(near(eyes[1].lookfrom - eyes[0].lookfrom, separation * cam.right()),
+        "the eyes are not offset along camera::right()");
+  check(near(eyes[1].lookat - eyes[0].lookat, separation * cam.right()),
+        "the eyes do not look parallel");
+
+  std::vector<render_view> views = { { eyes[0], "stereo_left.ppm" },
+                                     { eyes[1], "stereo_right.ppm" } };
+  auto faces = cube_map(cam);
+  for (std::size_t f = 0; f < faces.size(); ++f)
+    views.push_back({ faces[f], std::string("cube_") + cube_map_face_names[f] + ".ppm" });
+
+  // Each face looks along its axis of the base frame, with the base
+  // up as its up on the sides and the base forward on the poles
+  const vec3 forward = -cam.backward();
+  const vec3 expected_forward[6]
+    = { forward, -forward, -cam.right(), cam.right(), cam.up(), -cam.up() };
+  const vec3 expected_up[6]
+    = { cam.up(), cam.up(), cam.up(), cam.up(), -forward, forward };
+  for (std::size_t f = 0; f < faces.size(); ++f)
+  {
+    camera face = faces[f];
+    face.initialize();
+    check((-face.backward() - expected_forward[f]).length() < 1e-9,
+          std::string("the ") + cube_map_face_names[f] + " face looks the wrong way");
+    check((face.up() - expected_up[f]).length() < 1e-9,
+          std::string("the ") + cube_map_face_names[f] + " face is rotated");
+  }
+
+  thread_pool pool(2);
+  render_views(world, views, pool);
+
+  for (std::size_t k = 0; k < views.size(); ++k)
+  {
+    bool face = k >= 2;
+    int width  = cam.image_width;
+    int height = face ? width : cam.height();
+
+    image written;
+    check(written.load_ppm(views[k].path), views[k].path + " was not written");
+    check(written.width == width && written.height == height,
+          views[k].path + " is " + std::to_string(written.width) + "x"
+          + std::to_string(written.height));
+  }
+
+  // The eyes see the scene from different places
+  image left, right;
+  left.load_ppm("stereo_left.ppm");
+  right.load_ppm("stereo_right.ppm");
+  bool differ = false;
+  for (std::size_t k = 0; k < left.pixels.size() && k < right.pixels.size(); ++k)
+    differ |= !near(left.pixels[k], right.pixels[k]);
+  check(differ, "the left and right images are identical");
+
+  return check_failures();
+}
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Writes a paged scene several times larger than its resident budget
+// and compares hit() and hit_batch() with a bvh of the same spheres.
+// Also checks that corrupt files are rejected
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "paged_scene.hpp"
+#include "check.hpp"
+
+// Copies [source] to [path] with [value] written at [position]
+template <typename Value>
+void patch_file(const std::string& source, const std::string& path, std::size_t position,
+                Value value)
+{
+  std::ifstream in(source, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), {});
+  std::memcpy(bytes.data() + position, &value, sizeof(value));
+  std::ofstream(path, std::ios::binary).write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+int main(void)
+{
+  std::vector<std::shared_ptr<material>> materials;
+  for (int m = 0; m < 4; ++m)
+    materials.push_back(std::make_shared<lambertian>(color(0.2 * m, 0.5, 0.5)));
+
+  // About 11 MiB of spheres and nodes, the budget is four 1 MiB chunks
+  random_seed(1);
+  std::vector<paged_sphere> spheres(300000);
+  hittable_list list;
+  for (auto& s : spheres)
+  {
+    s = { { float(random_double(-50, 50)), float(random_double(-50, 50)),
+            float(random_double(-50, 50)) }, float(random_double(0.05, 0.3)),
+          std::uint32_t(random_double(0, 4)) };
+    list.add(std::make_shared<sphere>(point3(s.center[0], s.center[1], s.center[2]),
+                                      s.radius, materials[s.material]));
+  }
+  check(write_paged_scene(spheres, "test_paged.rtoc"), "could not write the scene");
+  bvh world(list);
+
+  const std::size_t budget = 4 * paged_scene::chunk_size;
+  paged_scene paged("test_paged.rtoc", materials, budget);
+  check(paged.ok(), "valid scene rejected");
+
+  std::vector<ray> rays;
+  for (int i = 0; i < 20000; ++i)
+    rays.emplace_back(point3(random_double(-60, 60), random_double(-60, 60), -60),
+                      vec3(random_double(-0.5, 0.5), random_double(-0.5, 0.5), 1));
+
+  // Both paths must find the same sphere, the paged ids are in tree
+  // order so the material stands in for the primitive
+  int single_mismatches = 0, hits = 0;
+  std::vector<hit_record> expected(rays.size());
+  std::vector<bool> expected_hit(rays.size());
+  for (std::size_t i = 0; i < rays.size(); ++i)
+  {
+    hit_record rec;
+    expected_hit[i] = world.hit(rays[i], interval(0.001, infinity), expected[i]);
+    bool hit = paged.hit(rays[i], interval(0.001, infinity), rec);
+    hits += hit;
+    single_mismatches += hit != expected_hit[i]
+      || (hit && (rec.t != expected[i].t || rec.mat != expected[i].mat));
+  }
+  check(hits > 1000, "too few rays hit the scene");
+  check(single_mismatches == 0,
+        std::to_string(single_mismatches) + " hit() results differ from the bvh");
+  check(paged.resident_bytes() <= budget, "hit() exceeded the resident budget");
+
+  std::vector<hit_record> recs;
+  auto batch_hits = paged.hit_batch(rays, interval(0.001, infinity), recs);
+  int batch_mismatches = 0;
+  for (std::size_t i = 0; i < rays.size(); ++i)
+    batch_mismatches += batch_hits[i] != expected_hit[i]
+      || (batch_hits[i] && (recs[i].t != expected[i].t || recs[i].mat != expected[i].mat));
+  check(batch_mismatches == 0,
+        std::to_string(batch_mismatches) + " hit_batch() results differ from the bvh");
+  check(paged.resident_bytes() <= budget, "hit_batch() exceeded the resident budget");
+  check(paged.page_ins() > budget / paged_scene::chunk_size, "no chunk was evicted");
+
+  // Header fields: magic, version, node count, sphere count, node
+  // offset, sphere offset
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", 8, std::uint64_t(1) << 40);
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "huge node count accepted");
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", 16, spheres.size() + 1);
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "sphere past the end accepted");
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", 32, std::uint64_t(-4096));
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "overflowing offset accepted");
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", 24, 4097);
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "misaligned nodes accepted");
+  check(!paged_scene("test_paged.rtoc", {}).ok(), "scene without materials accepted");
+
+  // Node fields: bounds, first, count, axis. The root is the first
+  // node, at the start of the second page
+  const std::size_t root = 4096;
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", root + 24, std::uint32_t(0x7fffffff));
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "child past the nodes accepted");
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", root + 24, std::uint32_t(0));
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "cycle to the root accepted");
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", root + 30, std::uint16_t(3));
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "split axis 3 accepted");
+  patch_file("test_paged.rtoc", "test_paged_bad.rtoc", root + 24, std::uint32_t(0xffffffff));
+  patch_file("test_paged_bad.rtoc", "test_paged_bad.rtoc", root + 28, std::uint16_t(2));
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "overflowing leaf accepted");
+
+  // A valid chain of inner nodes, each with a leaf on its left, one
+  // level too deep for the traversal stacks
+  std::vector<paged_node> chain;
+  for (int level = 0; level <= paged_scene::max_depth; ++level)
+  {
+    auto index = std::uint32_t(chain.size());
+    chain.push_back({ { -1, -1, -1, 1, 1, 1 }, index + 2, 0, 0 });
+    chain.push_back({ { -1, -1, -1, 1, 1, 1 }, 0, 1, 0 });
+  }
+  chain.push_back({ { -1, -1, -1, 1, 1, 1 }, 0, 1, 0 });
+  paged_sphere ball = { { 0, 0, 0 }, 1, 0 };
+  paged_scene_header header = { { 'R', 'T', 'O', 'C' }, 1, chain.size(), 1, root,
+                                root + chain.size() * sizeof(paged_node) };
+  {
+    std::ofstream out("test_paged_bad.rtoc", std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.seekp(std::streamoff(root));
+    out.write(reinterpret_cast<const char*>(chain.data()),
+              std::streamsize(chain.size() * sizeof(paged_node)));
+    out.write(reinterpret_cast<const char*>(&ball), sizeof(ball));
+  }
+  check(!paged_scene("test_paged_bad.rtoc", materials).ok(), "too deep hierarchy accepted");
+
+  // One level less is fine
+  chain.resize(chain.size() - 2);
+  chain.back() = { { -1, -1, -1, 1, 1, 1 }, 0, 1, 0 };
+  header.node_count    = chain.size();
+  header.sphere_offset = root + chain.size() * sizeof(paged_node);
+  {
+    std::ofstream out("test_paged_bad.rtoc", std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.seekp(std::streamoff(root));
+    out.write(reinterpret_cast<const char*>(chain.data()),
+              std::streamsize(chain.size() * sizeof(paged_node)));
+    out.write(reinterpret_cast<const char*>(&ball), sizeof(ball));
+  }
+  paged_scene deep("test_paged_bad.rtoc", materials);
+  hit_record deep_rec;
+  check(deep.ok() && deep.hit(ray(point3(0, 0, -5), vec3(0, 0, 1)), interval(0.001, infinity),
+                              deep_rec), "deepest allowed hierarchy rejected");
+  std::remove("test_paged_bad.rtoc");
+
+  // Material indices past the table get the last material
+  std::vector<paged_sphere> one = { { { 0, 0, 0 }, 1, 1000 } };
+  write_paged_scene(one, "test_paged_bad.rtoc");
+  paged_scene clamped("test_paged_bad.rtoc", materials);
+  hit_record rec;
+  check(clamped.hit(ray(point3(0, 0, -5), vec3(0, 0, 1)), interval(0.001, infinity), rec)
+        && rec.mat == materials.back(), "material index not clamped");
+  std::remove("test_paged_bad.rtoc");
+
+  std::remove("test_paged.rtoc");
+  return check_failures();
+}
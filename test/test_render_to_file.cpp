@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Renders the materials scene with render_to_file to PPM and PFM,
+// reloads both files and compares them with each other and with a
+// render in memory. Also checks that a file too large to allocate
+// makes mapped_image fail instead of crashing
+
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "raytracer.hpp"
+#include "mapped_image.hpp"
+#include "check.hpp"
+#include "scenes.hpp"
+
+// Reads a little endian PFM file written by mapped_image
+bool load_pfm(const std::string& path, image& result)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  int w = 0, h = 0;
+  double scale = 0;
+  if (!(in >> magic >> w >> h >> scale) || magic != "PF" || w <= 0 || h <= 0 || scale >= 0)
+    return false;
+  in.get();  // the single whitespace before the raster
+
+  result = image(w, h);
+  for (int j = h - 1; j >= 0; --j)  // bottom row first
+  {
+    for (int i = 0; i < w; ++i)
+    {
+      float rgb[3];
+      in.read(reinterpret_cast<char*>(rgb), sizeof(rgb));
+      result.row(j)[i] = color(rgb[0], rgb[1], rgb[2]);
+    }
+  }
+  return bool(in) && in.peek() == std::ifstream::traits_type::eof();
+}
+
+int gamma_byte(double linear)
+{
+  static const interval intensity(0.000, 0.999);
+  return int(256 * intensity.clamp(linear_to_gamma(linear)));
+}
+
+int main(void)
+{
+  camera cam = test_camera();
+  cam.image_width       = 40;
+  cam.samples_per_pixel = 4;
+  auto world = materials_scene(cam);
+  cam.initialize();
+  thread_pool pool(2);
+
+  // Tiles of 16 leave partial tiles on the right and bottom edges
+  check(render_to_file(cam, world, "test_render.ppm", image_format::ppm, pool, 16),
+        "could not render to the PPM file");
+  check(render_to_file(cam, world, "test_render.pfm", image_format::pfm, pool, 16),
+        "could not render to the PFM file");
+
+  image ppm, pfm;
+  check(ppm.load_ppm("test_render.ppm"), "could not reload the PPM file");
+  check(load_pfm("test_render.pfm", pfm), "could not reload the PFM file");
+  check(ppm.width == cam.image_width && ppm.height == cam.height(), "PPM file has the wrong size");
+  check(pfm.width == cam.image_width && pfm.height == cam.height(), "PFM file has the wrong size");
+
+  if (check_failures() == 0)
+  {
+    // Same render, the PPM only rounds it to 8 bits
+    int differences = 0;
+    for (std::size_t k = 0; k < pfm.pixels.size(); ++k)
+      for (int c = 0; c < 3; ++c)
+        differences += std::abs(gamma_byte(pfm.pixels[k][c])
+                                - int(std::lround(std::sqrt(ppm.pixels[k][c]) * 255))) > 1;
+    check(differences == 0, "PPM and PFM files differ");
+
+    // A single tile per row renders the same spans as render()
+    image memory;
+    cam.render(world, pool, memory);
+    check(render_to_file(cam, world, "test_render.pfm", image_format::pfm, pool,
+                         cam.image_width)
+          && load_pfm("test_render.pfm", pfm), "could not render to the PFM file");
+    int mismatches = 0;
+    for (std::size_t k = 0; k < pfm.pixels.size(); ++k)
+      for (int c = 0; c < 3; ++c)
+        mismatches += float(memory.pixels[k][c]) != float(pfm.pixels[k][c]);
+    check(mismatches == 0, "PFM file differs from the render in memory");
+  }
+  std::remove("test_render.ppm");
+  std::remove("test_render.pfm");
+
+  // Files over the size limit of the process cannot be allocated,
+  // like on a full disk
+  std::signal(SIGXFSZ, SIG_IGN);
+  rlimit limit{ 1 << 20, 1 << 20 };
+  ::setrlimit(RLIMIT_FSIZE, &limit);
+  mapped_image too_large("test_render_large.ppm", 2000, 2000, image_format::ppm);
+  check(!too_large.ok(), "image larger than the available space accepted");
+  check(!std::ifstream("test_render_large.ppm"), "partial image left behind");
+
+  return check_failures();
+}
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Moves, rotates and scales objects with transform, refits the bvh
+// and compares its hits against the plain list of the same objects.
+// Also renders a short sequence and checks the keyframe interpolation
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "check.hpp"
+
+bool near(const vec3& a, const vec3& b)
+{
+  return (a - b).length() < 1e-9;
+}
+
+// Fires random rays through the scene and counts the ones whose
+// closest hit differs between [world] and [list]
+int compare_hits(const bvh& world, const hittable_list& list)
+{
+  int mismatches = 0;
+  for (int i = 0; i < 4096; ++i)
+  {
+    ray r(point3(random_double(-8, 8), random_double(-8, 8), 10),
+          vec3(random_double(-0.5, 0.5), random_double(-0.5, 0.5), -1));
+    hit_record a, b;
+    bool hit_a = world.hit(r, interval(0.001, infinity), a);
+    bool hit_b = list.hit(r, interval(0.001, infinity), b);
+    mismatches += hit_a != hit_b
+      || (hit_a && (a.t != b.t || a.primitive != b.primitive || !near(a.normal, b.normal)));
+  }
+  return mismatches;
+}
+
+int main(void)
+{
+  random_seed(1);
+
+  // A single stretched and turned sphere, checked by hand
+  auto unit = std::make_shared<sphere>(point3(0, 0, 0), 1, nullptr);
+  transform stretched(unit, vec3(5, 0, 0), vec3(0, 0, 0), vec3(2, 1, 1));
+  hit_record rec;
+  check(stretched.hit(ray(point3(10, 0, 0), vec3(-1, 0, 0)), interval(0, infinity), rec)
+        && std::fabs(rec.t - 3) < 1e-9 && near(rec.p, point3(7, 0, 0))
+        && near(rec.normal, vec3(1, 0, 0)), "scaled sphere hit at the wrong place");
+
+  stretched.set(vec3(5, 0, 0), vec3(0, 0, 90), vec3(2, 1, 1));
+  check(stretched.hit(ray(point3(5, 10, 0), vec3(0, -1, 0)), interval(0, infinity), rec)
+        && std::fabs(rec.t - 8) < 1e-9 && near(rec.normal, vec3(0, 1, 0)),
+        "rotated sphere hit at the wrong place");
+  check(std::fabs(stretched.bounding_box().y.max - 2) < 1e-9
+        && std::fabs(stretched.bounding_box().x.max - 6) < 1e-9,
+        "rotated sphere has the wrong bounding box");
+
+  // A grid of spheres, half of them animated
+  hittable_list list;
+  sequence seq;
+  for (int i = 0; i < 8; ++i)
+  {
+    for (int j = 0; j < 8; ++j)
+    {
+      point3 center(2.0 * i - 7, 2.0 * j - 7, 0);
+      auto ball = std::make_shared<sphere>(point3(0, 0, 0), 0.6,
+                                           std::make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+      auto placed = std::make_shared<transform>(ball, center);
+      list.add(placed);
+      if ((i + j) % 2)
+        seq.object_tracks.push_back({ placed, {
+          { 0, center },
+          { 2, center + vec3(1, -1, 2), vec3(30, 60, 90), vec3(1.5, 0.5, 1) },
+        } });
+    }
+  }
+  bvh world(list);
+  check(compare_hits(world, list) == 0, "bvh differs from the list before animating");
+
+  // Render a few tiny frames, the objects end at their last key
+  seq.cam.image_width       = 16;
+  seq.cam.aspect_ratio      = 1;
+  seq.cam.samples_per_pixel = 1;
+  seq.cam.max_depth         = 2;
+  seq.cam.lookfrom          = point3(0, 0, 20);
+  seq.cam.lookat            = point3(0, 0, 0);
+  seq.frame_count           = 3;
+  seq.path_prefix           = "test_sequence_";
+  thread_pool pool(2);
+  seq.render(world, pool);
+
+  for (int n = 0; n < seq.frame_count; ++n)
+  {
+    image frame;
+    check(frame.load_ppm(seq.frame_path(n)), seq.frame_path(n) + " was not written");
+    std::remove(seq.frame_path(n).c_str());
+  }
+  check(compare_hits(world, list) == 0, "refitted bvh differs from the list");
+
+  // Move everything again by hand, far outside the original boxes
+  for (std::size_t k = 0; k < seq.object_tracks.size(); ++k)
+    seq.object_tracks[k].object->set(vec3(random_double(-6, 6), random_double(-6, 6), 3),
+                                     vec3(0, 0, random_double(0, 360)), vec3(2, 1, 0.5));
+  world.refit();
+  check(compare_hits(world, list) == 0, "bvh refitted by hand differs from the list");
+
+  // Camera keys, with and without vup and focus distance
+  seq.cam.vup        = vec3(0, 1, 0);
+  seq.cam.focus_dist = 7;
+  seq.camera_keys = {
+    { 0, point3(0, 0, 10), point3(0, 0, 0), 40, vec3(0, 1, 0), 10 },
+    { 4, point3(0, 0, 20), point3(0, 0, 0), 60, vec3(1, 0, 0), 20 },
+  };
+  camera middle = seq.camera_at(2);
+  check(near(middle.lookfrom, point3(0, 0, 15)) && std::fabs(middle.vfov - 50) < 1e-9,
+        "camera placement is not interpolated");
+  check(near(middle.vup, vec3(0.5, 0.5, 0)) && std::fabs(middle.focus_dist - 15) < 1e-9,
+        "vup and focus distance are not interpolated");
+
+  seq.camera_keys[1].vup        = vec3(0, 0, 0);
+  seq.camera_keys[1].focus_dist = 0;
+  middle = seq.camera_at(2);
+  check(near(middle.vup, vec3(0, 1, 0)) && middle.focus_dist == 7,
+        "unset keys do not keep the camera values");
+
+  return check_failures();
+}
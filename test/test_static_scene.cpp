@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Compares the hits of a static_scene, including their primitive ids,
+// with a hittable_list of the same spheres added in the same order
+
+#include <string>
+
+#include "raytracer.hpp"
+#include "check.hpp"
+#include "scenes.hpp"
+
+int main(void)
+{
+  camera cam = test_camera();
+  hittable_list list;
+  static_scene<sphere> world;
+  main_scene(cam, [&](const point3& center, double radius, std::shared_ptr<material> mat)
+  {
+    list.add(std::make_shared<sphere>(center, radius, mat));
+    world.add(sphere(center, radius, mat));
+  });
+
+  random_seed(1);
+  int mismatches = 0;
+  for (int i = 0; i < 20000; ++i)
+  {
+    ray r(point3(random_double(-12, 12), random_double(0.5, 4), random_double(-12, 12)),
+          vec3(random_double(-1, 1), -1, random_double(-1, 1)));
+    hit_record expected{}, rec{};
+    rec.primitive = -7;  // stale value from an earlier query
+    bool expected_hit = list.hit(r, interval(0.001, infinity), expected);
+    bool hit = world.hit(r, interval(0.001, infinity), rec);
+    mismatches += hit != expected_hit
+      || (hit && (rec.t != expected.t || rec.primitive != expected.primitive));
+  }
+  check(mismatches == 0, std::to_string(mismatches) + " hits differ from the list");
+
+  world.clear();
+  world.add(sphere(point3(0, 0, 0), 1, nullptr));
+  hit_record rec;
+  check(world.hit(ray(point3(0, 0, -5), vec3(0, 0, 1)), interval(0.001, infinity), rec)
+        && rec.primitive == 0, "ids do not restart after clear()");
+
+  return check_failures();
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Checks that parallel_for runs every index once, can be nested in a
+// task of the same pool, and that concurrent callers do not wait for
+// each other's work
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "check.hpp"
+
+int main(void)
+{
+  thread_pool pool(2);
+
+  std::vector<std::atomic<int>> runs(1000);
+  parallel_for(pool, int(runs.size()), [&](int i) { ++runs[std::size_t(i)]; });
+  bool once = true;
+  for (const auto& r : runs)
+    once = once && r == 1;
+  check(once, "an index did not run exactly once");
+
+  // Every worker blocked in a nested parallel_for, the waiting
+  // threads must run the inner tasks themselves
+  for (unsigned workers : { 1u, 2u })
+  {
+    thread_pool small(workers);
+    std::atomic<int> inner{0};
+    parallel_for(small, 4, [&](int)
+    {
+      parallel_for(small, 8, [&](int) { ++inner; });
+    });
+    check(inner == 32, "nested parallel_for lost tasks");
+  }
+
+  // A slow task of another job must not hold back a parallel_for
+  std::atomic<bool> release{false};
+  std::thread other([&]
+  {
+    parallel_for(pool, 1, [&](int)
+    {
+      while (!release)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  std::atomic<int> quick{0};
+  parallel_for(pool, 16, [&](int) { ++quick; });
+  check(quick == 16 && !release, "parallel_for waited for the work of another caller");
+
+  release = true;
+  other.join();
+
+  return check_failures();
+}
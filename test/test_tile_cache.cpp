@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+// Author:  Giovanni Santini
+// Mail:    giovanni.santini@proton.me
+// Github:  @San7o
+
+// Checks that corrupt tiled texture headers and tile caches too small
+// for their tiles are rejected, and that a cache stays under its cap
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "raytracer.hpp"
+#include "check.hpp"
+
+std::vector<char> read_file(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), {});
+}
+
+void write_file(const std::string& path, const std::vector<char>& bytes)
+{
+  std::ofstream(path, std::ios::binary).write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+// Replaces the 32 bit value at [position] of [bytes]
+std::vector<char> patched(std::vector<char> bytes, std::size_t position, std::uint32_t value)
+{
+  std::memcpy(bytes.data() + position, &value, sizeof(value));
+  return bytes;
+}
+
+int main(void)
+{
+  image source(200, 100);
+  for (std::size_t k = 0; k < source.pixels.size(); ++k)
+    source.pixels[k] = color(double(k % 7) / 7, 0.5, 0.2);
+  check(make_tiled_texture(source, "test_tiles.rttx", 16), "could not write the texture");
+  auto bytes = read_file("test_tiles.rttx");
+
+  check(tiled_texture_file("test_tiles.rttx").ok(), "valid texture rejected");
+
+  // Header: magic, tile size, level count, then width height offset
+  // of each level
+  write_file("test_tiles_bad.rttx", patched(bytes, 4, 0));
+  check(!tiled_texture_file("test_tiles_bad.rttx").ok(), "zero tile size accepted");
+  write_file("test_tiles_bad.rttx", patched(bytes, 4, 1u << 30));
+  check(!tiled_texture_file("test_tiles_bad.rttx").ok(), "huge tile size accepted");
+  write_file("test_tiles_bad.rttx", patched(bytes, 12, 0));
+  check(!tiled_texture_file("test_tiles_bad.rttx").ok(), "zero level width accepted");
+  write_file("test_tiles_bad.rttx", patched(bytes, 16, 1u << 20));
+  check(!tiled_texture_file("test_tiles_bad.rttx").ok(), "huge level height accepted");
+  write_file("test_tiles_bad.rttx", std::vector<char>(bytes.begin(), bytes.end() - 1));
+  check(!tiled_texture_file("test_tiles_bad.rttx").ok(), "truncated texture accepted");
+  std::remove("test_tiles_bad.rttx");
+
+  // A tile is 16 * 16 * 3 bytes, the cache has 16 shards
+  const std::size_t tile_bytes = 16 * 16 * 3;
+  hit_record rec;
+  rec.u = rec.v = 0.5;
+  image_texture small("test_tiles.rttx", std::make_shared<tile_cache>(16 * tile_bytes - 1));
+  check(small.value(rec).y() == 1 && small.value(rec).z() == 1,
+        "cache too small for one tile per shard accepted");
+
+  auto cache = std::make_shared<tile_cache>(16 * tile_bytes);
+  image_texture texture("test_tiles.rttx", cache);
+  random_seed(1);
+  for (int i = 0; i < 10000; ++i)
+  {
+    rec.u = random_double();
+    rec.v = random_double();
+    texture.value(rec);
+  }
+  auto stats = cache->stats();
+  check(stats.evictions > 0, "no tile was evicted");
+  check(stats.peak_bytes <= cache->capacity(),
+        "peak of " + std::to_string(stats.peak_bytes) + " bytes over the cap");
+
+  // Files opened 2^16 apart used to share cache keys. A file with
+  // bigger tiles must not get the tiles of the earlier one
+  make_tiled_texture(source, "test_tiles_large.rttx", 32);
+  tiled_texture_file small_tiles("test_tiles.rttx");
+  for (int k = 1; k < (1 << 16); ++k)
+    tiled_texture_file("test_tiles.rttx");
+  tiled_texture_file large_tiles("test_tiles_large.rttx");
+  check(large_tiles.id - small_tiles.id == (1 << 16), "unexpected file ids");
+
+  tile_cache shared;
+  shared.get(small_tiles, 0, 0, 0);
+  auto tile = shared.get(large_tiles, 0, 0, 0);
+  check(tile && tile->texels.size() == large_tiles.tile_bytes(),
+        "files with different ids share a cached tile");
+  std::remove("test_tiles_large.rttx");
+
+  std::remove("test_tiles.rttx");
+  return check_failures();
+}